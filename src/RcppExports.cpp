@@ -10,26 +10,245 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
-// cpp_format_cookies
-Rcpp::CharacterVector cpp_format_cookies(Rcpp::ListOf<Rcpp::List> cookies);
-RcppExport SEXP _RestRserve_cpp_format_cookies(SEXP cookiesSEXP) {
+// cpp_compress
+Rcpp::RawVector cpp_compress(SEXP x, const std::string& encoding, int level);
+RcppExport SEXP _RestRserve_cpp_compress(SEXP xSEXP, SEXP encodingSEXP, SEXP levelSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
-    Rcpp::traits::input_parameter< Rcpp::ListOf<Rcpp::List> >::type cookies(cookiesSEXP);
-    rcpp_result_gen = Rcpp::wrap(cpp_format_cookies(cookies));
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type encoding(encodingSEXP);
+    Rcpp::traits::input_parameter< int >::type level(levelSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_compress(x, encoding, level));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_compress_file
+bool cpp_compress_file(const std::string& path, const std::string& dest, const std::string& encoding, int level);
+RcppExport SEXP _RestRserve_cpp_compress_file(SEXP pathSEXP, SEXP destSEXP, SEXP encodingSEXP, SEXP levelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type dest(destSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type encoding(encodingSEXP);
+    Rcpp::traits::input_parameter< int >::type level(levelSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_compress_file(path, dest, encoding, level));
     return rcpp_result_gen;
 END_RCPP
 }
 // cpp_format_headers
-Rcpp::CharacterVector cpp_format_headers(Rcpp::ListOf<Rcpp::CharacterVector> x);
+Rcpp::CharacterVector cpp_format_headers(SEXP x);
 RcppExport SEXP _RestRserve_cpp_format_headers(SEXP xSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
-    Rcpp::traits::input_parameter< Rcpp::ListOf<Rcpp::CharacterVector> >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
     rcpp_result_gen = Rcpp::wrap(cpp_format_headers(x));
     return rcpp_result_gen;
 END_RCPP
 }
+// cpp_format_cookies
+Rcpp::CharacterVector cpp_format_cookies(SEXP cookies);
+RcppExport SEXP _RestRserve_cpp_format_cookies(SEXP cookiesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type cookies(cookiesSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_format_cookies(cookies));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_convert_response
+Rcpp::List cpp_convert_response(SEXP body, SEXP content_type, SEXP headers, SEXP cookies, SEXP status_code);
+RcppExport SEXP _RestRserve_cpp_convert_response(SEXP bodySEXP, SEXP content_typeSEXP, SEXP headersSEXP, SEXP cookiesSEXP, SEXP status_codeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type body(bodySEXP);
+    Rcpp::traits::input_parameter< SEXP >::type content_type(content_typeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type headers(headersSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type cookies(cookiesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type status_code(status_codeSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_convert_response(body, content_type, headers, cookies, status_code));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_hash_body
+Rcpp::CharacterVector cpp_hash_body(SEXP x);
+RcppExport SEXP _RestRserve_cpp_hash_body(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_hash_body(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_hash_file_init
+void cpp_hash_file_init();
+RcppExport SEXP _RestRserve_cpp_hash_file_init() {
+BEGIN_RCPP
+    cpp_hash_file_init();
+    return R_NilValue;
+END_RCPP
+}
+// cpp_hash_file
+Rcpp::CharacterVector cpp_hash_file(SEXP path);
+RcppExport SEXP _RestRserve_cpp_hash_file(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_hash_file(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_file_mtime
+double cpp_file_mtime(SEXP path);
+RcppExport SEXP _RestRserve_cpp_file_mtime(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_file_mtime(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_file_id
+Rcpp::CharacterVector cpp_file_id(SEXP path);
+RcppExport SEXP _RestRserve_cpp_file_id(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_file_id(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_format_http_date
+Rcpp::CharacterVector cpp_format_http_date(SEXP x);
+RcppExport SEXP _RestRserve_cpp_format_http_date(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_format_http_date(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_parse_http_date
+Rcpp::NumericVector cpp_parse_http_date(SEXP x);
+RcppExport SEXP _RestRserve_cpp_parse_http_date(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_parse_http_date(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_from_json
+SEXP cpp_from_json(SEXP x);
+RcppExport SEXP _RestRserve_cpp_from_json(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_from_json(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_to_json
+SEXP cpp_to_json(SEXP x, bool unbox);
+RcppExport SEXP _RestRserve_cpp_to_json(SEXP xSEXP, SEXP unboxSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< bool >::type unbox(unboxSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_to_json(x, unbox));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_log_sink_new
+SEXP cpp_log_sink_new(const std::string& target, const std::string& path, double buffer_size, double flush_interval, double max_size, int max_files);
+RcppExport SEXP _RestRserve_cpp_log_sink_new(SEXP targetSEXP, SEXP pathSEXP, SEXP buffer_sizeSEXP, SEXP flush_intervalSEXP, SEXP max_sizeSEXP, SEXP max_filesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string& >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< double >::type buffer_size(buffer_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type flush_interval(flush_intervalSEXP);
+    Rcpp::traits::input_parameter< double >::type max_size(max_sizeSEXP);
+    Rcpp::traits::input_parameter< int >::type max_files(max_filesSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_log_sink_new(target, path, buffer_size, flush_interval, max_size, max_files));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_log_sink_write
+void cpp_log_sink_write(SEXP ptr, SEXP line);
+RcppExport SEXP _RestRserve_cpp_log_sink_write(SEXP ptrSEXP, SEXP lineSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type line(lineSEXP);
+    cpp_log_sink_write(ptr, line);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_log_sink_entry
+void cpp_log_sink_entry(SEXP ptr, double timestamp, SEXP level, SEXP name, int pid, SEXP msg, SEXP extra);
+RcppExport SEXP _RestRserve_cpp_log_sink_entry(SEXP ptrSEXP, SEXP timestampSEXP, SEXP levelSEXP, SEXP nameSEXP, SEXP pidSEXP, SEXP msgSEXP, SEXP extraSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< double >::type timestamp(timestampSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type level(levelSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type name(nameSEXP);
+    Rcpp::traits::input_parameter< int >::type pid(pidSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type msg(msgSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type extra(extraSEXP);
+    cpp_log_sink_entry(ptr, timestamp, level, name, pid, msg, extra);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_log_sink_flush
+void cpp_log_sink_flush(SEXP ptr);
+RcppExport SEXP _RestRserve_cpp_log_sink_flush(SEXP ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    cpp_log_sink_flush(ptr);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_parse_media_type
+SEXP cpp_parse_media_type(SEXP x);
+RcppExport SEXP _RestRserve_cpp_parse_media_type(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_parse_media_type(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_parse_accept
+SEXP cpp_parse_accept(SEXP x);
+RcppExport SEXP _RestRserve_cpp_parse_accept(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_parse_accept(x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_negotiate_media_type
+int cpp_negotiate_media_type(SEXP accept, Rcpp::CharacterVector available);
+RcppExport SEXP _RestRserve_cpp_negotiate_media_type(SEXP acceptSEXP, SEXP availableSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type accept(acceptSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type available(availableSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_negotiate_media_type(accept, available));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_negotiate_encoding
+int cpp_negotiate_encoding(SEXP accept_encoding, Rcpp::CharacterVector available);
+RcppExport SEXP _RestRserve_cpp_negotiate_encoding(SEXP accept_encodingSEXP, SEXP availableSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type accept_encoding(accept_encodingSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type available(availableSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_negotiate_encoding(accept_encoding, available));
+    return rcpp_result_gen;
+END_RCPP
+}
 // cpp_parse_cookies
 Rcpp::List cpp_parse_cookies(Rcpp::CharacterVector x);
 RcppExport SEXP _RestRserve_cpp_parse_cookies(SEXP xSEXP) {
@@ -62,13 +281,15 @@ BEGIN_RCPP
 END_RCPP
 }
 // cpp_parse_multipart_body
-Rcpp::List cpp_parse_multipart_body(Rcpp::RawVector body, const char* boundary);
-RcppExport SEXP _RestRserve_cpp_parse_multipart_body(SEXP bodySEXP, SEXP boundarySEXP) {
+Rcpp::List cpp_parse_multipart_body(Rcpp::RawVector body, const char* boundary, double spill_threshold, std::string spill_prefix);
+RcppExport SEXP _RestRserve_cpp_parse_multipart_body(SEXP bodySEXP, SEXP boundarySEXP, SEXP spill_thresholdSEXP, SEXP spill_prefixSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< Rcpp::RawVector >::type body(bodySEXP);
     Rcpp::traits::input_parameter< const char* >::type boundary(boundarySEXP);
-    rcpp_result_gen = Rcpp::wrap(cpp_parse_multipart_body(body, boundary));
+    Rcpp::traits::input_parameter< double >::type spill_threshold(spill_thresholdSEXP);
+    Rcpp::traits::input_parameter< std::string >::type spill_prefix(spill_prefixSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_parse_multipart_body(body, boundary, spill_threshold, spill_prefix));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -84,12 +305,323 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// cpp_parse_query
+Rcpp::List cpp_parse_query(SEXP x, SEXP types);
+RcppExport SEXP _RestRserve_cpp_parse_query(SEXP xSEXP, SEXP typesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type types(typesSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_parse_query(x, types));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_reset_fields
+void cpp_reset_fields(SEXP env, SEXP values);
+RcppExport SEXP _RestRserve_cpp_reset_fields(SEXP envSEXP, SEXP valuesSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type env(envSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type values(valuesSEXP);
+    cpp_reset_fields(env, values);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_copy_fields
+void cpp_copy_fields(SEXP from, SEXP to, SEXP fields);
+RcppExport SEXP _RestRserve_cpp_copy_fields(SEXP fromSEXP, SEXP toSEXP, SEXP fieldsSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type to(toSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type fields(fieldsSEXP);
+    cpp_copy_fields(from, to, fields);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_range_response
+SEXP cpp_range_response(SEXP body, const std::string& content_type, SEXP range, SEXP if_range, SEXP etag, SEXP last_modified, double max_window, SEXP tmp);
+RcppExport SEXP _RestRserve_cpp_range_response(SEXP bodySEXP, SEXP content_typeSEXP, SEXP rangeSEXP, SEXP if_rangeSEXP, SEXP etagSEXP, SEXP last_modifiedSEXP, SEXP max_windowSEXP, SEXP tmpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type body(bodySEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type content_type(content_typeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type range(rangeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type if_range(if_rangeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type etag(etagSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type last_modified(last_modifiedSEXP);
+    Rcpp::traits::input_parameter< double >::type max_window(max_windowSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type tmp(tmpSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_range_response(body, content_type, range, if_range, etag, last_modified, max_window, tmp));
+    return rcpp_result_gen;
+END_RCPP
+}
+// raw_view
+SEXP raw_view(SEXP x, R_xlen_t offset, R_xlen_t size);
+RcppExport SEXP _RestRserve_raw_view(SEXP xSEXP, SEXP offsetSEXP, SEXP sizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< R_xlen_t >::type offset(offsetSEXP);
+    Rcpp::traits::input_parameter< R_xlen_t >::type size(sizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(raw_view(x, offset, size));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_request_id
+SEXP cpp_request_id(SEXP incoming);
+RcppExport SEXP _RestRserve_cpp_request_id(SEXP incomingSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type incoming(incomingSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_request_id(incoming));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_response_cache_new
+SEXP cpp_response_cache_new(double capacity, double max_entry_size, double max_size, Rcpp::NumericVector ttl);
+RcppExport SEXP _RestRserve_cpp_response_cache_new(SEXP capacitySEXP, SEXP max_entry_sizeSEXP, SEXP max_sizeSEXP, SEXP ttlSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< double >::type capacity(capacitySEXP);
+    Rcpp::traits::input_parameter< double >::type max_entry_size(max_entry_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type max_size(max_sizeSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type ttl(ttlSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_response_cache_new(capacity, max_entry_size, max_size, ttl));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_response_cache_get
+SEXP cpp_response_cache_get(SEXP ptr, const std::string& method, const std::string& path, SEXP query, SEXP headers);
+RcppExport SEXP _RestRserve_cpp_response_cache_get(SEXP ptrSEXP, SEXP methodSEXP, SEXP pathSEXP, SEXP querySEXP, SEXP headersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type query(querySEXP);
+    Rcpp::traits::input_parameter< SEXP >::type headers(headersSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_response_cache_get(ptr, method, path, query, headers));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_response_cache_set
+bool cpp_response_cache_set(SEXP ptr, const std::string& method, const std::string& path, SEXP query, SEXP req_headers, SEXP status_code, SEXP body, SEXP content_type, SEXP headers);
+RcppExport SEXP _RestRserve_cpp_response_cache_set(SEXP ptrSEXP, SEXP methodSEXP, SEXP pathSEXP, SEXP querySEXP, SEXP req_headersSEXP, SEXP status_codeSEXP, SEXP bodySEXP, SEXP content_typeSEXP, SEXP headersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type query(querySEXP);
+    Rcpp::traits::input_parameter< SEXP >::type req_headers(req_headersSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type status_code(status_codeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type body(bodySEXP);
+    Rcpp::traits::input_parameter< SEXP >::type content_type(content_typeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type headers(headersSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_response_cache_set(ptr, method, path, query, req_headers, status_code, body, content_type, headers));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_response_cache_clear
+void cpp_response_cache_clear(SEXP ptr);
+RcppExport SEXP _RestRserve_cpp_response_cache_clear(SEXP ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    cpp_response_cache_clear(ptr);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_response_cache_info
+SEXP cpp_response_cache_info(SEXP ptr);
+RcppExport SEXP _RestRserve_cpp_response_cache_info(SEXP ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_response_cache_info(ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_router_new
+SEXP cpp_router_new();
+RcppExport SEXP _RestRserve_cpp_router_new() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    rcpp_result_gen = Rcpp::wrap(cpp_router_new());
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_router_add
+void cpp_router_add(SEXP ptr, const std::string& path, const std::string& match, const std::string& id, std::vector<std::string> names, std::vector<std::string> types, std::vector<int> pos);
+RcppExport SEXP _RestRserve_cpp_router_add(SEXP ptrSEXP, SEXP pathSEXP, SEXP matchSEXP, SEXP idSEXP, SEXP namesSEXP, SEXP typesSEXP, SEXP posSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type match(matchSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type id(idSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type names(namesSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type types(typesSEXP);
+    Rcpp::traits::input_parameter< std::vector<int> >::type pos(posSEXP);
+    cpp_router_add(ptr, path, match, id, names, types, pos);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_router_match
+SEXP cpp_router_match(SEXP ptr, const std::string& path, bool extract_vars);
+RcppExport SEXP _RestRserve_cpp_router_match(SEXP ptrSEXP, SEXP pathSEXP, SEXP extract_varsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< bool >::type extract_vars(extract_varsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_router_match(ptr, path, extract_vars));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_route_set_new
+SEXP cpp_route_set_new(SEXP routes, SEXP partial);
+RcppExport SEXP _RestRserve_cpp_route_set_new(SEXP routesSEXP, SEXP partialSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type routes(routesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type partial(partialSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_route_set_new(routes, partial));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_route_set_match
+bool cpp_route_set_match(SEXP ptr, const std::string& path);
+RcppExport SEXP _RestRserve_cpp_route_set_match(SEXP ptrSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_route_set_match(ptr, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_route_set_match_kind
+Rcpp::CharacterVector cpp_route_set_match_kind(SEXP ptr, const std::string& path);
+RcppExport SEXP _RestRserve_cpp_route_set_match_kind(SEXP ptrSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_route_set_match_kind(ptr, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_shared_store_new
+SEXP cpp_shared_store_new(double capacity, double max_key_size, double max_value_size, double stripes);
+RcppExport SEXP _RestRserve_cpp_shared_store_new(SEXP capacitySEXP, SEXP max_key_sizeSEXP, SEXP max_value_sizeSEXP, SEXP stripesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< double >::type capacity(capacitySEXP);
+    Rcpp::traits::input_parameter< double >::type max_key_size(max_key_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type max_value_size(max_value_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type stripes(stripesSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_shared_store_new(capacity, max_key_size, max_value_size, stripes));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_shared_store_get
+SEXP cpp_shared_store_get(SEXP ptr, SEXP key);
+RcppExport SEXP _RestRserve_cpp_shared_store_get(SEXP ptrSEXP, SEXP keySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type key(keySEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_shared_store_get(ptr, key));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_shared_store_set
+bool cpp_shared_store_set(SEXP ptr, SEXP key, SEXP value, double ttl);
+RcppExport SEXP _RestRserve_cpp_shared_store_set(SEXP ptrSEXP, SEXP keySEXP, SEXP valueSEXP, SEXP ttlSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type key(keySEXP);
+    Rcpp::traits::input_parameter< SEXP >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< double >::type ttl(ttlSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_shared_store_set(ptr, key, value, ttl));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_shared_store_incr
+double cpp_shared_store_incr(SEXP ptr, SEXP key, double by, double ttl);
+RcppExport SEXP _RestRserve_cpp_shared_store_incr(SEXP ptrSEXP, SEXP keySEXP, SEXP bySEXP, SEXP ttlSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type key(keySEXP);
+    Rcpp::traits::input_parameter< double >::type by(bySEXP);
+    Rcpp::traits::input_parameter< double >::type ttl(ttlSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_shared_store_incr(ptr, key, by, ttl));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_shared_store_delete
+bool cpp_shared_store_delete(SEXP ptr, SEXP key);
+RcppExport SEXP _RestRserve_cpp_shared_store_delete(SEXP ptrSEXP, SEXP keySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type key(keySEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_shared_store_delete(ptr, key));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_shared_store_clear
+void cpp_shared_store_clear(SEXP ptr);
+RcppExport SEXP _RestRserve_cpp_shared_store_clear(SEXP ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    cpp_shared_store_clear(ptr);
+    return R_NilValue;
+END_RCPP
+}
+// cpp_shared_store_info
+SEXP cpp_shared_store_info(SEXP ptr);
+RcppExport SEXP _RestRserve_cpp_shared_store_info(SEXP ptrSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_shared_store_info(ptr));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_static_index_new
+SEXP cpp_static_index_new(const std::string& url_path, const std::string& file_path, SEXP content_type, Rcpp::CharacterVector mime_types, double cache_size, double cache_max_file, bool refresh);
+RcppExport SEXP _RestRserve_cpp_static_index_new(SEXP url_pathSEXP, SEXP file_pathSEXP, SEXP content_typeSEXP, SEXP mime_typesSEXP, SEXP cache_sizeSEXP, SEXP cache_max_fileSEXP, SEXP refreshSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string& >::type url_path(url_pathSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type file_path(file_pathSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type content_type(content_typeSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type mime_types(mime_typesSEXP);
+    Rcpp::traits::input_parameter< double >::type cache_size(cache_sizeSEXP);
+    Rcpp::traits::input_parameter< double >::type cache_max_file(cache_max_fileSEXP);
+    Rcpp::traits::input_parameter< bool >::type refresh(refreshSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_static_index_new(url_path, file_path, content_type, mime_types, cache_size, cache_max_file, refresh));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cpp_static_serve
+SEXP cpp_static_serve(SEXP ptr, const std::string& path, SEXP headers);
+RcppExport SEXP _RestRserve_cpp_static_serve(SEXP ptrSEXP, SEXP pathSEXP, SEXP headersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ptr(ptrSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type headers(headersSEXP);
+    rcpp_result_gen = Rcpp::wrap(cpp_static_serve(ptr, path, headers));
+    return rcpp_result_gen;
+END_RCPP
+}
 // cpp_url_decode
 Rcpp::CharacterVector cpp_url_decode(Rcpp::CharacterVector x);
 RcppExport SEXP _RestRserve_cpp_url_decode(SEXP xSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
-    Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
     rcpp_result_gen = Rcpp::wrap(cpp_url_decode(x));
     return rcpp_result_gen;
@@ -100,7 +632,6 @@ Rcpp::CharacterVector cpp_url_encode(Rcpp::CharacterVector x);
 RcppExport SEXP _RestRserve_cpp_url_encode(SEXP xSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
-    Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type x(xSEXP);
     rcpp_result_gen = Rcpp::wrap(cpp_url_encode(x));
     return rcpp_result_gen;
@@ -108,19 +639,67 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_RestRserve_cpp_format_cookies", (DL_FUNC) &_RestRserve_cpp_format_cookies, 1},
+    {"_RestRserve_cpp_compress", (DL_FUNC) &_RestRserve_cpp_compress, 3},
+    {"_RestRserve_cpp_compress_file", (DL_FUNC) &_RestRserve_cpp_compress_file, 4},
     {"_RestRserve_cpp_format_headers", (DL_FUNC) &_RestRserve_cpp_format_headers, 1},
+    {"_RestRserve_cpp_format_cookies", (DL_FUNC) &_RestRserve_cpp_format_cookies, 1},
+    {"_RestRserve_cpp_convert_response", (DL_FUNC) &_RestRserve_cpp_convert_response, 5},
+    {"_RestRserve_cpp_hash_body", (DL_FUNC) &_RestRserve_cpp_hash_body, 1},
+    {"_RestRserve_cpp_hash_file_init", (DL_FUNC) &_RestRserve_cpp_hash_file_init, 0},
+    {"_RestRserve_cpp_hash_file", (DL_FUNC) &_RestRserve_cpp_hash_file, 1},
+    {"_RestRserve_cpp_file_mtime", (DL_FUNC) &_RestRserve_cpp_file_mtime, 1},
+    {"_RestRserve_cpp_file_id", (DL_FUNC) &_RestRserve_cpp_file_id, 1},
+    {"_RestRserve_cpp_format_http_date", (DL_FUNC) &_RestRserve_cpp_format_http_date, 1},
+    {"_RestRserve_cpp_parse_http_date", (DL_FUNC) &_RestRserve_cpp_parse_http_date, 1},
+    {"_RestRserve_cpp_from_json", (DL_FUNC) &_RestRserve_cpp_from_json, 1},
+    {"_RestRserve_cpp_to_json", (DL_FUNC) &_RestRserve_cpp_to_json, 2},
+    {"_RestRserve_cpp_log_sink_new", (DL_FUNC) &_RestRserve_cpp_log_sink_new, 6},
+    {"_RestRserve_cpp_log_sink_write", (DL_FUNC) &_RestRserve_cpp_log_sink_write, 2},
+    {"_RestRserve_cpp_log_sink_entry", (DL_FUNC) &_RestRserve_cpp_log_sink_entry, 7},
+    {"_RestRserve_cpp_log_sink_flush", (DL_FUNC) &_RestRserve_cpp_log_sink_flush, 1},
+    {"_RestRserve_cpp_parse_media_type", (DL_FUNC) &_RestRserve_cpp_parse_media_type, 1},
+    {"_RestRserve_cpp_parse_accept", (DL_FUNC) &_RestRserve_cpp_parse_accept, 1},
+    {"_RestRserve_cpp_negotiate_media_type", (DL_FUNC) &_RestRserve_cpp_negotiate_media_type, 2},
+    {"_RestRserve_cpp_negotiate_encoding", (DL_FUNC) &_RestRserve_cpp_negotiate_encoding, 2},
     {"_RestRserve_cpp_parse_cookies", (DL_FUNC) &_RestRserve_cpp_parse_cookies, 1},
     {"_RestRserve_cpp_parse_headers", (DL_FUNC) &_RestRserve_cpp_parse_headers, 2},
     {"_RestRserve_cpp_parse_multipart_boundary", (DL_FUNC) &_RestRserve_cpp_parse_multipart_boundary, 1},
-    {"_RestRserve_cpp_parse_multipart_body", (DL_FUNC) &_RestRserve_cpp_parse_multipart_body, 2},
+    {"_RestRserve_cpp_parse_multipart_body", (DL_FUNC) &_RestRserve_cpp_parse_multipart_body, 4},
     {"_RestRserve_raw_slice", (DL_FUNC) &_RestRserve_raw_slice, 3},
+    {"_RestRserve_cpp_parse_query", (DL_FUNC) &_RestRserve_cpp_parse_query, 2},
+    {"_RestRserve_cpp_reset_fields", (DL_FUNC) &_RestRserve_cpp_reset_fields, 2},
+    {"_RestRserve_cpp_copy_fields", (DL_FUNC) &_RestRserve_cpp_copy_fields, 3},
+    {"_RestRserve_cpp_range_response", (DL_FUNC) &_RestRserve_cpp_range_response, 8},
+    {"_RestRserve_raw_view", (DL_FUNC) &_RestRserve_raw_view, 3},
+    {"_RestRserve_cpp_request_id", (DL_FUNC) &_RestRserve_cpp_request_id, 1},
+    {"_RestRserve_cpp_response_cache_new", (DL_FUNC) &_RestRserve_cpp_response_cache_new, 4},
+    {"_RestRserve_cpp_response_cache_get", (DL_FUNC) &_RestRserve_cpp_response_cache_get, 5},
+    {"_RestRserve_cpp_response_cache_set", (DL_FUNC) &_RestRserve_cpp_response_cache_set, 9},
+    {"_RestRserve_cpp_response_cache_clear", (DL_FUNC) &_RestRserve_cpp_response_cache_clear, 1},
+    {"_RestRserve_cpp_response_cache_info", (DL_FUNC) &_RestRserve_cpp_response_cache_info, 1},
+    {"_RestRserve_cpp_router_new", (DL_FUNC) &_RestRserve_cpp_router_new, 0},
+    {"_RestRserve_cpp_router_add", (DL_FUNC) &_RestRserve_cpp_router_add, 7},
+    {"_RestRserve_cpp_router_match", (DL_FUNC) &_RestRserve_cpp_router_match, 3},
+    {"_RestRserve_cpp_route_set_new", (DL_FUNC) &_RestRserve_cpp_route_set_new, 2},
+    {"_RestRserve_cpp_route_set_match", (DL_FUNC) &_RestRserve_cpp_route_set_match, 2},
+    {"_RestRserve_cpp_route_set_match_kind", (DL_FUNC) &_RestRserve_cpp_route_set_match_kind, 2},
+    {"_RestRserve_cpp_shared_store_new", (DL_FUNC) &_RestRserve_cpp_shared_store_new, 4},
+    {"_RestRserve_cpp_shared_store_get", (DL_FUNC) &_RestRserve_cpp_shared_store_get, 2},
+    {"_RestRserve_cpp_shared_store_set", (DL_FUNC) &_RestRserve_cpp_shared_store_set, 4},
+    {"_RestRserve_cpp_shared_store_incr", (DL_FUNC) &_RestRserve_cpp_shared_store_incr, 4},
+    {"_RestRserve_cpp_shared_store_delete", (DL_FUNC) &_RestRserve_cpp_shared_store_delete, 2},
+    {"_RestRserve_cpp_shared_store_clear", (DL_FUNC) &_RestRserve_cpp_shared_store_clear, 1},
+    {"_RestRserve_cpp_shared_store_info", (DL_FUNC) &_RestRserve_cpp_shared_store_info, 1},
+    {"_RestRserve_cpp_static_index_new", (DL_FUNC) &_RestRserve_cpp_static_index_new, 7},
+    {"_RestRserve_cpp_static_serve", (DL_FUNC) &_RestRserve_cpp_static_serve, 3},
     {"_RestRserve_cpp_url_decode", (DL_FUNC) &_RestRserve_cpp_url_decode, 1},
     {"_RestRserve_cpp_url_encode", (DL_FUNC) &_RestRserve_cpp_url_encode, 1},
     {NULL, NULL, 0}
 };
 
+void init_raw_view(DllInfo* dll);
 RcppExport void R_init_RestRserve(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    init_raw_view(dll);
 }
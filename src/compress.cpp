@@ -0,0 +1,176 @@
+#include <Rcpp.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <zlib.h>
+
+// zlib window bits for the HTTP content codings:
+// 'gzip' - gzip wrapper, 'deflate' - zlib wrapper (RFC 7230 section 4.2.2)
+static int window_bits(const std::string& encoding) {
+  if (encoding == "gzip" || encoding == "x-gzip") {
+    return 15 + 16;
+  }
+  if (encoding == "deflate") {
+    return 15;
+  }
+  Rcpp::stop("unsupported content coding '%s'.", encoding);
+}
+
+static void check_level(int level) {
+  if (level < 1 || level > 9) {
+    Rcpp::stop("'level' must be an integer between 1 and 9.");
+  }
+}
+
+class Deflater {
+public:
+  Deflater(const std::string& encoding, int level) {
+    int bits = window_bits(encoding);
+    check_level(level);
+    std::memset(&zs_, 0, sizeof(zs_));
+    if (deflateInit2(&zs_, level, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      Rcpp::stop("Can't initialize zlib stream.");
+    }
+  }
+  ~Deflater() {
+    deflateEnd(&zs_);
+  }
+  std::size_t bound(std::size_t n) {
+    return deflateBound(&zs_, static_cast<uLong>(n));
+  }
+  // compresses 'n' bytes and appends output to 'out'
+  void write(const unsigned char* p, std::size_t n, bool finish, std::vector<unsigned char>& out) {
+    const std::size_t step = 1 << 16;
+    zs_.next_in = const_cast<Bytef*>(p);
+    zs_.avail_in = static_cast<uInt>(n);
+    do {
+      std::size_t used = out.size();
+      out.resize(used + step);
+      zs_.next_out = out.data() + used;
+      zs_.avail_out = static_cast<uInt>(step);
+      if (deflate(&zs_, finish ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR) {
+        Rcpp::stop("zlib compression failed.");
+      }
+      out.resize(used + step - zs_.avail_out);
+    } while (zs_.avail_out == 0);
+  }
+private:
+  z_stream zs_;
+};
+
+// compresses raw vector or string body in one call
+// character bodies are concatenated as they are sent by the backend
+// [[Rcpp::export(rng=false)]]
+Rcpp::RawVector cpp_compress(SEXP x, const std::string& encoding, int level = 6) {
+  Deflater deflater(encoding, level);
+  std::string input;
+  const unsigned char* p;
+  std::size_t n;
+  if (TYPEOF(x) == RAWSXP) {
+    p = RAW(x);
+    n = Rf_xlength(x);
+  } else if (TYPEOF(x) == STRSXP) {
+    R_xlen_t len = Rf_xlength(x);
+    if (len == 1 && STRING_ELT(x, 0) != NA_STRING) {
+      p = reinterpret_cast<const unsigned char*>(CHAR(STRING_ELT(x, 0)));
+      n = LENGTH(STRING_ELT(x, 0));
+    } else {
+      for (R_xlen_t i = 0; i < len; ++i) {
+        SEXP el = STRING_ELT(x, i);
+        if (el != NA_STRING) {
+          input.append(CHAR(el), LENGTH(el));
+        }
+      }
+      p = reinterpret_cast<const unsigned char*>(input.data());
+      n = input.size();
+    }
+  } else {
+    Rcpp::stop("'x' must be raw or character vector.");
+  }
+  std::vector<unsigned char> out;
+  out.reserve(deflater.bound(n));
+  deflater.write(p, n, true, out);
+  Rcpp::RawVector res(out.size());
+  std::memcpy(RAW(res), out.data(), out.size());
+  return res;
+}
+
+// closes file on scope exit (including Rcpp::stop)
+class FileHandle {
+public:
+  FileHandle(const std::string& path, const char* mode) : f_(std::fopen(path.c_str(), mode)) {}
+  ~FileHandle() {
+    if (f_ != nullptr) {
+      std::fclose(f_);
+    }
+  }
+  std::FILE* get() const {
+    return f_;
+  }
+  // returns false if buffered data can't be written
+  bool close() {
+    int res = std::fclose(f_);
+    f_ = nullptr;
+    return res == 0;
+  }
+private:
+  std::FILE* f_;
+  FileHandle(const FileHandle&);
+  FileHandle& operator=(const FileHandle&);
+};
+
+static bool compress_file(const std::string& from, const std::string& to, Deflater& deflater) {
+  FileHandle in(from, "rb");
+  if (in.get() == nullptr) {
+    return false;
+  }
+  FileHandle out(to, "wb");
+  if (out.get() == nullptr) {
+    return false;
+  }
+  const std::size_t chunk = 1 << 16;
+  std::vector<unsigned char> buf(chunk);
+  std::vector<unsigned char> out_buf;
+  while (true) {
+    std::size_t n = std::fread(buf.data(), 1, chunk, in.get());
+    if (std::ferror(in.get())) {
+      return false;
+    }
+    bool finish = n < chunk;
+    out_buf.clear();
+    deflater.write(buf.data(), n, finish, out_buf);
+    if (std::fwrite(out_buf.data(), 1, out_buf.size(), out.get()) != out_buf.size()) {
+      return false;
+    }
+    if (finish) {
+      break;
+    }
+  }
+  return out.close();
+}
+
+// compresses file 'path' to 'dest' in chunks
+// output is written to a temporary file which is renamed to 'dest' at the end,
+// so concurrent workers never see partially written files
+// [[Rcpp::export(rng=false)]]
+bool cpp_compress_file(const std::string& path, const std::string& dest,
+                       const std::string& encoding, int level = 6) {
+  Deflater deflater(encoding, level);
+  std::string from = R_ExpandFileName(path.c_str());
+  std::string to = R_ExpandFileName(dest.c_str());
+  std::string tmp = to + ".tmp" + std::to_string(static_cast<long>(getpid()));
+  bool ok;
+  try {
+    ok = compress_file(from, tmp, deflater);
+  } catch (...) {
+    std::remove(tmp.c_str());
+    throw;
+  }
+  if (!ok || std::rename(tmp.c_str(), to.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,251 @@
+#include <Rcpp.h>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+// collects pieces of the response head and joins them into
+// exactly-sized buffer in the end
+class HeadWriter {
+public:
+  void append(sv x) {
+    pieces_.push_back(x);
+    size_ += x.size();
+  }
+  void append(SEXP x) {
+    append(sv(CHAR(x), LENGTH(x)));
+  }
+  // for values which are not backed by R strings
+  void append_owned(std::string x) {
+    storage_.push_back(std::move(x));
+    append(sv(storage_.back()));
+  }
+  // each header field starts from new line (no CRLF after the last one)
+  void start_field() {
+    if (n_fields_++ > 0) {
+      append(sv("\r\n", 2));
+    }
+  }
+  bool empty() const {
+    return n_fields_ == 0;
+  }
+  SEXP str() const {
+    std::string res(size_, '\0');
+    char* out = &res[0];
+    for (const sv& x : pieces_) {
+      std::memcpy(out, x.data(), x.size());
+      out += x.size();
+    }
+    return Rf_mkCharLen(res.data(), size_);
+  }
+private:
+  std::vector<sv> pieces_;
+  std::deque<std::string> storage_;
+  std::size_t size_ = 0;
+  std::size_t n_fields_ = 0;
+};
+
+static SEXP list_elt(SEXP x, const char* name) {
+  SEXP nms = Rf_getAttrib(x, R_NamesSymbol);
+  if (Rf_isNull(nms)) {
+    return R_NilValue;
+  }
+  R_xlen_t n = Rf_xlength(x);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    if (std::strcmp(CHAR(STRING_ELT(nms, i)), name) == 0) {
+      return VECTOR_ELT(x, i);
+    }
+  }
+  return R_NilValue;
+}
+
+static bool is_true(SEXP x) {
+  return TYPEOF(x) == LGLSXP && Rf_xlength(x) == 1 && LOGICAL(x)[0] == TRUE;
+}
+
+static SEXP cookie_string(SEXP x, const char* name) {
+  if (TYPEOF(x) != STRSXP || Rf_xlength(x) != 1 || STRING_ELT(x, 0) == NA_STRING) {
+    Rcpp::stop("cookie '%s' must be a string.", name);
+  }
+  return STRING_ELT(x, 0);
+}
+
+// 'keep' holds coerced header values until the head is written
+static void write_headers(HeadWriter& out, SEXP headers, std::vector<Rcpp::RObject>& keep) {
+  if (Rf_isNull(headers)) {
+    return;
+  }
+  if (TYPEOF(headers) != VECSXP) {
+    Rcpp::stop("'headers' must be a list.");
+  }
+  R_xlen_t n = Rf_xlength(headers);
+  if (n == 0) {
+    return;
+  }
+  SEXP nms = Rf_getAttrib(headers, R_NamesSymbol);
+  if (Rf_isNull(nms)) {
+    Rcpp::stop("'headers' must be named.");
+  }
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP values = VECTOR_ELT(headers, i);
+    switch (TYPEOF(values)) {
+    case STRSXP:
+      break;
+    case LGLSXP:
+    case INTSXP:
+    case REALSXP:
+      keep.emplace_back(Rf_coerceVector(values, STRSXP));
+      values = keep.back();
+      break;
+    default:
+      Rcpp::stop("header value must be a character vector.");
+    }
+    R_xlen_t n_values = Rf_xlength(values);
+    if (n_values == 0 || (n_values == 1 && LENGTH(STRING_ELT(values, 0)) == 0)) {
+      continue;
+    }
+    out.start_field();
+    out.append(STRING_ELT(nms, i));
+    out.append(sv(": ", 2));
+    for (R_xlen_t j = 0; j < n_values; ++j) {
+      if (j > 0) {
+        out.append(sv(", ", 2));
+      }
+      out.append(STRING_ELT(values, j));
+    }
+  }
+}
+
+static void write_cookies(HeadWriter& out, SEXP cookies) {
+  if (Rf_isNull(cookies)) {
+    return;
+  }
+  if (TYPEOF(cookies) != VECSXP) {
+    Rcpp::stop("'cookies' must be a list.");
+  }
+  R_xlen_t n = Rf_xlength(cookies);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP cookie = VECTOR_ELT(cookies, i);
+    SEXP name = TYPEOF(cookie) == VECSXP ? list_elt(cookie, "name") : R_NilValue;
+    SEXP value = TYPEOF(cookie) == VECSXP ? list_elt(cookie, "value") : R_NilValue;
+    if (Rf_isNull(name) || Rf_isNull(value)) {
+      Rcpp::stop("cookie object must contain 'name' and 'value' elements.");
+    }
+    out.start_field();
+    out.append(sv("Set-Cookie: ", 12));
+    out.append(cookie_string(name, "name"));
+    out.append(sv("=", 1));
+    out.append(cookie_string(value, "value"));
+    SEXP expires = list_elt(cookie, "expires");
+    if (!Rf_isNull(expires)) {
+      out.append(sv("; Expires=", 10));
+      out.append(cookie_string(expires, "expires"));
+    }
+    SEXP max_age = list_elt(cookie, "max_age");
+    if (!Rf_isNull(max_age)) {
+      if (Rf_xlength(max_age) != 1 || (TYPEOF(max_age) != INTSXP && TYPEOF(max_age) != REALSXP)) {
+        Rcpp::stop("cookie 'max_age' must be a number.");
+      }
+      out.append(sv("; Max-Age=", 10));
+      out.append_owned(std::to_string(static_cast<long long>(Rf_asReal(max_age))));
+    }
+    SEXP path = list_elt(cookie, "path");
+    if (!Rf_isNull(path)) {
+      out.append(sv("; Path=", 7));
+      out.append(cookie_string(path, "path"));
+    }
+    SEXP domain = list_elt(cookie, "domain");
+    if (!Rf_isNull(domain)) {
+      out.append(sv("; Domain=", 9));
+      out.append(cookie_string(domain, "domain"));
+    }
+    if (is_true(list_elt(cookie, "secure"))) {
+      out.append(sv("; Secure", 8));
+    }
+    if (is_true(list_elt(cookie, "http_only"))) {
+      out.append(sv("; HttpOnly", 10));
+    }
+    SEXP same_site = list_elt(cookie, "same_site");
+    if (!Rf_isNull(same_site)) {
+      out.append(sv("; SameSite=", 11));
+      out.append(cookie_string(same_site, "same_site"));
+    }
+  }
+}
+
+// [[Rcpp::export(rng=false)]]
+Rcpp::CharacterVector cpp_format_headers(SEXP x) {
+  if (!Rf_isNull(x) && TYPEOF(x) != VECSXP) {
+    Rcpp::stop("'x' must be a list.");
+  }
+  if (Rf_xlength(x) > 0 && Rf_isNull(Rf_getAttrib(x, R_NamesSymbol))) {
+    Rcpp::stop("'x' must be named.");
+  }
+  HeadWriter out;
+  std::vector<Rcpp::RObject> keep;
+  write_headers(out, x, keep);
+  Rcpp::CharacterVector res(1);
+  SET_STRING_ELT(res, 0, out.str());
+  return res;
+}
+
+// [[Rcpp::export(rng=false)]]
+Rcpp::CharacterVector cpp_format_cookies(SEXP cookies) {
+  HeadWriter out;
+  write_cookies(out, cookies);
+  Rcpp::CharacterVector res(1);
+  SET_STRING_ELT(res, 0, out.str());
+  return res;
+}
+
+// builds list(body, content_type, headers, status_code) expected by Rserve
+// see BackendRserve$convert_response()
+// [[Rcpp::export(rng=false)]]
+Rcpp::List cpp_convert_response(SEXP body, SEXP content_type, SEXP headers, SEXP cookies,
+                                SEXP status_code) {
+  HeadWriter out;
+  std::vector<Rcpp::RObject> keep;
+  write_headers(out, headers, keep);
+  write_cookies(out, cookies);
+  Rcpp::CharacterVector head(out.empty() ? 0 : 1);
+  if (!out.empty()) {
+    SET_STRING_ELT(head, 0, out.str());
+  }
+
+  Rcpp::List res(4);
+  res[2] = head;
+  // files are served "as is" by Rserve (no call to response$encode())
+  if (TYPEOF(body) == STRSXP && Rf_xlength(body) == 1) {
+    SEXP body_name = Rf_getAttrib(body, R_NamesSymbol);
+    if (!Rf_isNull(body_name)) {
+      SEXP nm = STRING_ELT(body_name, 0);
+      if (std::strcmp(CHAR(nm), "file") == 0 || std::strcmp(CHAR(nm), "tmpfile") == 0) {
+        Rcpp::CharacterVector path(1);
+        SET_STRING_ELT(path, 0, STRING_ELT(body, 0));
+        Rcpp::CharacterVector res_names(4);
+        SET_STRING_ELT(res_names, 0, nm);
+        res[0] = path;
+        res[1] = content_type;
+        res[3] = status_code;
+        res.names() = res_names;
+        return res;
+      }
+    }
+  }
+  if (Rf_isNull(body)) {
+    res[0] = Rcpp::RawVector(0);
+  } else if (TYPEOF(body) == RAWSXP || TYPEOF(body) == STRSXP) {
+    res[0] = body;
+  } else {
+    res[0] = "500 Internal Server Error (body is not character or raw)";
+    res[1] = "text/plain";
+    res[3] = 500;
+    return res;
+  }
+  res[1] = content_type;
+  res[3] = status_code;
+  return res;
+}
@@ -0,0 +1,341 @@
+#include <Rcpp.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include "utils.h"
+
+// streaming xxHash64 (seed = 0)
+// see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+class XXH64 {
+public:
+  XXH64() {
+    v_[0] = P1 + P2;
+    v_[1] = P2;
+    v_[2] = 0;
+    v_[3] = 0 - P1;
+  }
+  void update(const unsigned char* p, std::size_t n) {
+    total_ += n;
+    if (buf_n_ + n < 32) {
+      std::memcpy(buf_ + buf_n_, p, n);
+      buf_n_ += n;
+      return;
+    }
+    if (buf_n_ > 0) {
+      std::size_t fill = 32 - buf_n_;
+      std::memcpy(buf_ + buf_n_, p, fill);
+      process_stripe(buf_);
+      p += fill;
+      n -= fill;
+      buf_n_ = 0;
+    }
+    while (n >= 32) {
+      process_stripe(p);
+      p += 32;
+      n -= 32;
+    }
+    std::memcpy(buf_, p, n);
+    buf_n_ = n;
+  }
+  uint64_t digest() const {
+    uint64_t h;
+    if (total_ >= 32) {
+      h = rotl(v_[0], 1) + rotl(v_[1], 7) + rotl(v_[2], 12) + rotl(v_[3], 18);
+      for (int i = 0; i < 4; ++i) {
+        h = merge_round(h, v_[i]);
+      }
+    } else {
+      h = P5;
+    }
+    h += total_;
+    const unsigned char* p = buf_;
+    std::size_t n = buf_n_;
+    while (n >= 8) {
+      h ^= round(0, read64(p));
+      h = rotl(h, 27) * P1 + P4;
+      p += 8;
+      n -= 8;
+    }
+    if (n >= 4) {
+      h ^= static_cast<uint64_t>(read32(p)) * P1;
+      h = rotl(h, 23) * P2 + P3;
+      p += 4;
+      n -= 4;
+    }
+    while (n > 0) {
+      h ^= (*p) * P5;
+      h = rotl(h, 11) * P1;
+      ++p;
+      --n;
+    }
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+  }
+  // 16 hex digits
+  std::string hex() const {
+    static const char digits[] = "0123456789abcdef";
+    uint64_t h = digest();
+    std::string res(16, '0');
+    for (int i = 15; i >= 0; --i) {
+      res[i] = digits[h & 0xf];
+      h >>= 4;
+    }
+    return res;
+  }
+private:
+  static const uint64_t P1 = 11400714785074694791ULL;
+  static const uint64_t P2 = 14029467366897019727ULL;
+  static const uint64_t P3 = 1609587929392839161ULL;
+  static const uint64_t P4 = 9650029242287828579ULL;
+  static const uint64_t P5 = 2870177450012600261ULL;
+
+  static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+  }
+  // little endian regardless of the platform
+  static uint64_t read64(const unsigned char* p) {
+    uint64_t res = 0;
+    for (int i = 7; i >= 0; --i) {
+      res = (res << 8) | p[i];
+    }
+    return res;
+  }
+  static uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+      (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+  }
+  static uint64_t round(uint64_t acc, uint64_t x) {
+    acc += x * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+  }
+  static uint64_t merge_round(uint64_t acc, uint64_t x) {
+    acc ^= round(0, x);
+    return acc * P1 + P4;
+  }
+  void process_stripe(const unsigned char* p) {
+    for (int i = 0; i < 4; ++i) {
+      v_[i] = round(v_[i], read64(p + i * 8));
+    }
+  }
+
+  uint64_t v_[4];
+  unsigned char buf_[32];
+  std::size_t buf_n_ = 0;
+  uint64_t total_ = 0;
+};
+
+// identity of the file content (see utils.h) - if any of these changes file is hashed again
+bool stat_file(const char* path, FileId& res) {
+  struct stat st;
+  if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  res.dev = static_cast<double>(st.st_dev);
+  res.ino = static_cast<double>(st.st_ino);
+  res.size = static_cast<double>(st.st_size);
+#if defined(__APPLE__)
+  res.mtime = st.st_mtimespec.tv_sec + st.st_mtimespec.tv_nsec / 1e9;
+#elif defined(_WIN32)
+  res.mtime = static_cast<double>(st.st_mtime);
+#else
+  res.mtime = st.st_mtim.tv_sec + st.st_mtim.tv_nsec / 1e9;
+#endif
+  return true;
+}
+
+uint64_t hash_bytes(const char* p, std::size_t n) {
+  XXH64 h;
+  h.update(reinterpret_cast<const unsigned char*>(p), n);
+  return h.digest();
+}
+
+static bool hash_file(const char* path, std::string& res) {
+  std::FILE* f = std::fopen(path, "rb");
+  if (f == NULL) {
+    return false;
+  }
+  XXH64 h;
+  std::vector<unsigned char> buf(1 << 20);
+  std::size_t n;
+  while ((n = std::fread(buf.data(), 1, buf.size(), f)) > 0) {
+    h.update(buf.data(), n);
+  }
+  bool ok = !std::ferror(f);
+  std::fclose(f);
+  res = h.hex();
+  return ok;
+}
+
+// file hashes by path, entries are valid while the file identity is the same
+class FileHashCache {
+public:
+  bool get(const std::string& path, const FileId& id, std::string& hash) const {
+    auto it = cache_.find(path);
+    if (it == cache_.end() || !(it->second.id == id)) {
+      return false;
+    }
+    hash = it->second.hash;
+    return true;
+  }
+  void set(const std::string& path, const FileId& id, const std::string& hash) {
+    if (cache_.size() >= max_size) {
+      cache_.clear();
+    }
+    cache_[path] = Entry{id, hash};
+  }
+private:
+  struct Entry {
+    FileId id;
+    std::string hash;
+  };
+  static const std::size_t max_size = 4096;
+  std::unordered_map<std::string, Entry> cache_;
+};
+
+// used if the shared store can't be mapped or the path is too long
+static FileHashCache file_hash_cache;
+
+// file identity followed by the hash
+static const std::size_t file_hash_entry_size = sizeof(FileId) + 16;
+// mapped on the first use (see cpp_hash_file_init) rather than when the
+// package is loaded, hashes computed by the Rserve children forked after that
+// are shared with the others
+static SharedStore* file_hash_store = nullptr;
+static bool file_hash_store_mapped = false;
+
+static void file_hash_store_init() {
+  if (!file_hash_store_mapped) {
+    file_hash_store_mapped = true;
+    file_hash_store = shared_store_new(4096, 1024, file_hash_entry_size, 16);
+  }
+}
+
+static bool file_hash_get(const std::string& path, const FileId& id, std::string& hash) {
+  std::string value;
+  if (file_hash_store == nullptr || !shared_store_get(file_hash_store, path, value)) {
+    return file_hash_cache.get(path, id, hash);
+  }
+  FileId stored;
+  if (value.size() != file_hash_entry_size) {
+    return false;
+  }
+  std::memcpy(&stored, value.data(), sizeof(FileId));
+  if (!(stored == id)) {
+    return false;
+  }
+  hash.assign(value, sizeof(FileId), std::string::npos);
+  return true;
+}
+
+static void file_hash_set(const std::string& path, const FileId& id, const std::string& hash) {
+  std::string value(reinterpret_cast<const char*>(&id), sizeof(FileId));
+  value.append(hash);
+  if (file_hash_store == nullptr ||
+      !shared_store_set(file_hash_store, path, value, R_PosInf)) {
+    file_hash_cache.set(path, id, hash);
+  }
+}
+
+// hash of the raw vector or strings (without serialization)
+// [[Rcpp::export(rng=false)]]
+Rcpp::CharacterVector cpp_hash_body(SEXP x) {
+  XXH64 h;
+  if (TYPEOF(x) == RAWSXP) {
+    h.update(RAW(x), Rf_xlength(x));
+  } else if (TYPEOF(x) == STRSXP) {
+    R_xlen_t n = Rf_xlength(x);
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SEXP el = STRING_ELT(x, i);
+      // separate elements, so c("ab", "c") and c("a", "bc") differ
+      if (i > 0) {
+        h.update(reinterpret_cast<const unsigned char*>("\0"), 1);
+      }
+      if (el == NA_STRING) {
+        continue;
+      }
+      h.update(reinterpret_cast<const unsigned char*>(CHAR(el)), LENGTH(el));
+    }
+  } else {
+    Rcpp::stop("'x' must be raw or character vector.");
+  }
+  return Rcpp::CharacterVector(h.hex());
+}
+
+// maps shared store of the file hashes, called before the backend forks
+// [[Rcpp::export(rng=false)]]
+void cpp_hash_file_init() {
+  file_hash_store_init();
+}
+
+// hash of the file content, files are read only when they are changed
+// (device, inode, size or modification time) since the previous call in
+// any of the processes forked after the store was mapped
+// returns NA if the file can't be read
+// [[Rcpp::export(rng=false)]]
+Rcpp::CharacterVector cpp_hash_file(SEXP path) {
+  if (TYPEOF(path) != STRSXP || Rf_xlength(path) != 1 || STRING_ELT(path, 0) == NA_STRING) {
+    Rcpp::stop("'path' must be a string.");
+  }
+  file_hash_store_init();
+  const char* p = R_ExpandFileName(Rf_translateChar(STRING_ELT(path, 0)));
+  std::string key(p);
+  FileId id;
+  std::string hash;
+  Rcpp::CharacterVector res(1);
+  if (!stat_file(p, id)) {
+    SET_STRING_ELT(res, 0, NA_STRING);
+    return res;
+  }
+  if (!file_hash_get(key, id, hash)) {
+    if (!hash_file(p, hash)) {
+      SET_STRING_ELT(res, 0, NA_STRING);
+      return res;
+    }
+    file_hash_set(key, id, hash);
+  }
+  SET_STRING_ELT(res, 0, Rf_mkCharLen(hash.data(), hash.size()));
+  return res;
+}
+
+// modification time of the file (seconds since epoch) or NA
+// cheaper alternative to file.info() which builds a data.frame
+// [[Rcpp::export(rng=false)]]
+double cpp_file_mtime(SEXP path) {
+  if (TYPEOF(path) != STRSXP || Rf_xlength(path) != 1 || STRING_ELT(path, 0) == NA_STRING) {
+    Rcpp::stop("'path' must be a string.");
+  }
+  FileId id;
+  if (!stat_file(R_ExpandFileName(Rf_translateChar(STRING_ELT(path, 0))), id)) {
+    return NA_REAL;
+  }
+  return id.mtime;
+}
+
+// identity of the file (device, inode, size and modification time) as hex
+// string or NA, changes whenever the file is replaced or modified
+// [[Rcpp::export(rng=false)]]
+Rcpp::CharacterVector cpp_file_id(SEXP path) {
+  if (TYPEOF(path) != STRSXP || Rf_xlength(path) != 1 || STRING_ELT(path, 0) == NA_STRING) {
+    Rcpp::stop("'path' must be a string.");
+  }
+  FileId id;
+  Rcpp::CharacterVector res(1);
+  if (!stat_file(R_ExpandFileName(Rf_translateChar(STRING_ELT(path, 0))), id)) {
+    SET_STRING_ELT(res, 0, NA_STRING);
+    return res;
+  }
+  XXH64 h;
+  h.update(reinterpret_cast<const unsigned char*>(&id), sizeof(FileId));
+  std::string hex = h.hex();
+  SET_STRING_ELT(res, 0, Rf_mkCharLen(hex.data(), hex.size()));
+  return res;
+}
@@ -0,0 +1,290 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+// HTTP dates are always in English and GMT, so neither strftime() nor
+// strptime() (which depend on LC_TIME) are used here
+// see https://datatracker.ietf.org/doc/html/rfc7231#section-7.1.1.1
+
+static const char* const day_names[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char* const month_names[12] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+static int days_in_month(std::int64_t y, int m) {
+  static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+  return m == 2 && leap ? 29 : days[m - 1];
+}
+
+static void write_2d(char* out, int x) {
+  out[0] = static_cast<char>('0' + x / 10);
+  out[1] = static_cast<char>('0' + x % 10);
+}
+
+// writes IMF-fixdate ('Sun, 06 Nov 1994 08:49:37 GMT') to 'out'
+// returns number of written bytes (29 for years 0-9999)
+std::size_t format_http_date(double x, char* out) {
+  std::int64_t secs = static_cast<std::int64_t>(std::floor(x));
+  std::int64_t days = secs / 86400;
+  std::int64_t rem = secs % 86400;
+  if (rem < 0) {
+    rem += 86400;
+    days -= 1;
+  }
+  std::int64_t y;
+  int m, d;
+  civil_from_days(days, y, m, d);
+  int wday = static_cast<int>((days % 7 + 11) % 7);
+  char* p = out;
+  std::memcpy(p, day_names[wday], 3);
+  p += 3;
+  *p++ = ',';
+  *p++ = ' ';
+  write_2d(p, d);
+  p += 2;
+  *p++ = ' ';
+  std::memcpy(p, month_names[m - 1], 3);
+  p += 3;
+  *p++ = ' ';
+  std::string year = std::to_string(y);
+  if (y >= 0 && y < 1000) {
+    year.insert(0, 4 - year.size(), '0');
+  }
+  std::memcpy(p, year.data(), year.size());
+  p += year.size();
+  *p++ = ' ';
+  write_2d(p, static_cast<int>(rem / 3600));
+  p += 2;
+  *p++ = ':';
+  write_2d(p, static_cast<int>(rem % 3600 / 60));
+  p += 2;
+  *p++ = ':';
+  write_2d(p, static_cast<int>(rem % 60));
+  p += 2;
+  std::memcpy(p, " GMT", 4);
+  p += 4;
+  return p - out;
+}
+
+static bool take_char(sv& x, char c) {
+  if (x.empty() || x.front() != c) {
+    return false;
+  }
+  x.remove_prefix(1);
+  return true;
+}
+
+// reads from 'min_n' to 'max_n' digits
+static bool take_int(sv& x, std::size_t min_n, std::size_t max_n, int& res) {
+  std::size_t n = 0;
+  res = 0;
+  while (n < x.size() && n < max_n && x[n] >= '0' && x[n] <= '9') {
+    res = res * 10 + (x[n] - '0');
+    ++n;
+  }
+  x.remove_prefix(n);
+  return n >= min_n;
+}
+
+static void skip_alpha(sv& x) {
+  while (!x.empty() && ((x.front() >= 'a' && x.front() <= 'z') || (x.front() >= 'A' && x.front() <= 'Z'))) {
+    x.remove_prefix(1);
+  }
+}
+
+static bool take_month(sv& x, int& res) {
+  if (x.size() < 3) {
+    return false;
+  }
+  for (int i = 0; i < 12; ++i) {
+    const char* nm = month_names[i];
+    bool eq = true;
+    for (int j = 0; j < 3; ++j) {
+      eq = eq && (x[j] | 0x20) == (nm[j] | 0x20);
+    }
+    if (eq) {
+      res = i + 1;
+      x.remove_prefix(3);
+      return true;
+    }
+  }
+  return false;
+}
+
+// 'HH:MM:SS'
+static bool take_time(sv& x, int& h, int& mi, int& s) {
+  return take_int(x, 2, 2, h) && take_char(x, ':') &&
+    take_int(x, 2, 2, mi) && take_char(x, ':') &&
+    take_int(x, 2, 2, s);
+}
+
+// IMF-fixdate 'Sun, 06 Nov 1994 08:49:37 GMT'
+// or obsolete RFC 850 'Sunday, 06-Nov-94 08:49:37 GMT'
+static bool parse_imf_date(sv x, std::int64_t& y, int& m, int& d, int& h, int& mi, int& s) {
+  int year;
+  skip_alpha(x);
+  if (!take_char(x, ',') || !take_char(x, ' ') || !take_int(x, 1, 2, d)) {
+    return false;
+  }
+  char sep = x.empty() ? '\0' : x.front();
+  if ((sep != ' ' && sep != '-') || !take_char(x, sep) || !take_month(x, m) || !take_char(x, sep)) {
+    return false;
+  }
+  std::size_t year_len = x.size();
+  if (!take_int(x, 2, 4, year)) {
+    return false;
+  }
+  year_len -= x.size();
+  if (year_len == 2) {
+    year += year < 70 ? 2000 : 1900;
+  } else if (year_len != 4) {
+    return false;
+  }
+  y = year;
+  return take_char(x, ' ') && take_time(x, h, mi, s) && x == " GMT";
+}
+
+// asctime 'Sun Nov  6 08:49:37 1994'
+static bool parse_asctime_date(sv x, std::int64_t& y, int& m, int& d, int& h, int& mi, int& s) {
+  int year;
+  skip_alpha(x);
+  if (!take_char(x, ' ') || !take_month(x, m) || !take_char(x, ' ')) {
+    return false;
+  }
+  take_char(x, ' ');
+  if (!take_int(x, 1, 2, d) || !take_char(x, ' ') || !take_time(x, h, mi, s) ||
+      !take_char(x, ' ') || !take_int(x, 4, 4, year) || !x.empty()) {
+    return false;
+  }
+  y = year;
+  return true;
+}
+
+// not HTTP dates, but were accepted by ETagMiddleware before:
+// 'YYYY-MM-DD', 'YYYY/MM/DD' optionally followed by ' HH:MM[:SS[.ffff]]'
+// or 'THH:MM:SSZ'
+static bool parse_iso_date(sv x, std::int64_t& y, int& m, int& d, int& h, int& mi, int& s, double& frac) {
+  int year;
+  if (!take_int(x, 4, 4, year) || x.empty()) {
+    return false;
+  }
+  char sep = x.front();
+  if ((sep != '-' && sep != '/') || !take_char(x, sep) || !take_int(x, 1, 2, m) ||
+      !take_char(x, sep) || !take_int(x, 1, 2, d)) {
+    return false;
+  }
+  y = year;
+  h = mi = s = 0;
+  frac = 0;
+  if (x.empty()) {
+    return true;
+  }
+  bool iso = x.front() == 'T';
+  if ((!take_char(x, ' ') && !take_char(x, 'T')) || !take_int(x, 2, 2, h) ||
+      !take_char(x, ':') || !take_int(x, 2, 2, mi)) {
+    return false;
+  }
+  if (take_char(x, ':')) {
+    if (!take_int(x, 2, 2, s)) {
+      return false;
+    }
+    if (take_char(x, '.')) {
+      double scale = 0.1;
+      while (!x.empty() && x.front() >= '0' && x.front() <= '9') {
+        frac += (x.front() - '0') * scale;
+        scale /= 10;
+        x.remove_prefix(1);
+      }
+    }
+  }
+  if (iso) {
+    take_char(x, 'Z');
+  }
+  return x.empty();
+}
+
+// returns seconds since epoch or NA if 'x' is not a valid date
+double parse_http_date(sv x) {
+  x = sv_trim(x);
+  std::int64_t y = 0;
+  int m = 0, d = 0, h = 0, mi = 0, s = 0;
+  double frac = 0;
+  bool ok;
+  if (!x.empty() && x.front() >= '0' && x.front() <= '9') {
+    ok = parse_iso_date(x, y, m, d, h, mi, s, frac);
+  } else if (x.size() > 3 && x[3] == ' ') {
+    ok = parse_asctime_date(x, y, m, d, h, mi, s);
+  } else {
+    ok = parse_imf_date(x, y, m, d, h, mi, s);
+  }
+  if (!ok || m < 1 || m > 12 || d < 1 || d > days_in_month(y, m) || h > 23 || mi > 59 || s > 60) {
+    return NA_REAL;
+  }
+  return days_from_civil(y, m, d) * 86400.0 + h * 3600 + mi * 60 + s + frac;
+}
+
+// 'Date' header changes once per second while it is formatted for each response
+class HttpDateCache {
+public:
+  SEXP get(double x) {
+    double secs = std::floor(x);
+    if (value_ == R_NilValue || secs != secs_) {
+      char buf[64];
+      std::size_t n = format_http_date(secs, buf);
+      if (value_ != R_NilValue) {
+        R_ReleaseObject(value_);
+      }
+      value_ = Rf_mkCharLen(buf, n);
+      R_PreserveObject(value_);
+      secs_ = secs;
+    }
+    return value_;
+  }
+private:
+  double secs_ = 0;
+  SEXP value_ = R_NilValue;
+};
+
+static HttpDateCache http_date_cache;
+
+// 'x' - seconds since epoch (POSIXct)
+// [[Rcpp::export(rng=false)]]
+Rcpp::CharacterVector cpp_format_http_date(SEXP x) {
+  if (TYPEOF(x) != REALSXP && TYPEOF(x) != INTSXP) {
+    Rcpp::stop("'x' must be numeric.");
+  }
+  Rcpp::NumericVector values(x);
+  R_xlen_t n = values.size();
+  Rcpp::CharacterVector res(n);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    double value = values[i];
+    // years 0-9999
+    if (!std::isfinite(value) || value < -62167219200.0 || value >= 253402300800.0) {
+      SET_STRING_ELT(res, i, NA_STRING);
+    } else {
+      SET_STRING_ELT(res, i, http_date_cache.get(value));
+    }
+  }
+  return res;
+}
+
+// accepts all three formats from RFC 7231 (IMF-fixdate, RFC 850, asctime)
+// returns seconds since epoch, NA for invalid dates
+// [[Rcpp::export(rng=false)]]
+Rcpp::NumericVector cpp_parse_http_date(SEXP x) {
+  if (!Rf_isNull(x) && TYPEOF(x) != STRSXP) {
+    Rcpp::stop("'x' must be character vector.");
+  }
+  R_xlen_t n = Rf_xlength(x);
+  Rcpp::NumericVector res(n);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP el = STRING_ELT(x, i);
+    res[i] = el == NA_STRING ? NA_REAL : parse_http_date(sv(CHAR(el), LENGTH(el)));
+  }
+  return res;
+}
@@ -0,0 +1,725 @@
+#include <Rcpp.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+// JSON decoder which produces the same R objects as
+// jsonlite::parse_json(simplifyVector = TRUE, simplifyDataFrame = FALSE, simplifyMatrix = FALSE)
+//
+// Works in two stages:
+// 1. input is validated and flattened into a tape of nodes (byte offsets
+//    into the input, no copies). Containers know the number of children and
+//    the kinds of their elements, so arrays of scalars can be simplified
+//    without looking at the elements twice.
+// 2. R objects are built from the tape. Vectors are allocated once with the
+//    final type and length. Stage 2 never fails, so no R object is allocated
+//    for invalid input.
+
+enum NodeType : uint8_t {
+  NODE_NULL, NODE_TRUE, NODE_FALSE, NODE_INT, NODE_DBL, NODE_STR, NODE_ARR, NODE_OBJ
+};
+
+// string flags
+static const uint8_t STR_ESCAPED = 1;
+static const uint8_t STR_NA = 2; // "NA"
+static const uint8_t STR_NUM = 4; // "NaN", "Inf", "-Inf"
+
+// array flags - kinds of the elements
+static const uint8_t HAS_CONTAINER = 1;
+static const uint8_t HAS_LGL = 2;
+static const uint8_t HAS_INT = 4;
+static const uint8_t HAS_DBL = 8;
+static const uint8_t HAS_STR = 16;
+static const uint8_t HAS_NULL = 32;
+static const uint8_t HAS_NA_STR = 64;
+static const uint8_t HAS_NUM_STR = 128;
+
+static const std::size_t max_depth = 1024;
+
+struct JsonNode {
+  uint32_t pos; // byte offset of the value (for strings - after the opening quote)
+  uint32_t len; // length in bytes (strings, numbers), number of children (containers)
+  uint32_t next; // tape index after the container
+  NodeType type;
+  uint8_t flags;
+};
+
+// true if any of 8 bytes is '"', '\\', control character or non-ASCII
+static inline bool string_special8(uint64_t x) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t high = 0x8080808080808080ULL;
+  uint64_t quote = x ^ (ones * '"');
+  uint64_t slash = x ^ (ones * '\\');
+  uint64_t res = ((x - ones * 0x20) | ((quote - ones) & ~quote) | ((slash - ones) & ~slash)) & ~x & high;
+  return (res | (x & high)) != 0;
+}
+
+static inline int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static void append_utf8(std::string& out, uint32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+// ---- stage 1 ----
+
+class JsonTapeBuilder {
+public:
+  JsonTapeBuilder(const char* s, std::size_t n, std::vector<JsonNode>& tape) :
+    s_(s), n_(n), tape_(tape) {}
+
+  void build() {
+    // UTF-8 byte order mark
+    if (n_ >= 3 && std::memcmp(s_, "\xEF\xBB\xBF", 3) == 0) {
+      i_ = 3;
+    }
+    skip_ws();
+    if (i_ == n_) {
+      fail("empty input");
+    }
+    parse_value(0);
+    skip_ws();
+    if (i_ != n_) {
+      fail("unexpected content after the JSON value");
+    }
+  }
+
+private:
+  const char* s_;
+  std::size_t n_;
+  std::size_t i_ = 0;
+  std::vector<JsonNode>& tape_;
+
+  [[noreturn]] void fail(const char* msg) {
+    Rcpp::stop("JSON parse error at byte offset %s: %s.", std::to_string(i_), msg);
+  }
+
+  void skip_ws() {
+    while (i_ < n_ && (s_[i_] == ' ' || s_[i_] == '\n' || s_[i_] == '\r' || s_[i_] == '\t')) {
+      ++i_;
+    }
+  }
+
+  std::size_t push(NodeType type, std::size_t pos, std::size_t len, uint8_t flags) {
+    JsonNode node;
+    node.pos = static_cast<uint32_t>(pos);
+    node.len = static_cast<uint32_t>(len);
+    node.next = 0;
+    node.type = type;
+    node.flags = flags;
+    tape_.push_back(node);
+    return tape_.size() - 1;
+  }
+
+  void parse_value(std::size_t depth) {
+    if (i_ == n_) {
+      fail("unexpected end of input");
+    }
+    switch (s_[i_]) {
+      case '{': parse_object(depth + 1); break;
+      case '[': parse_array(depth + 1); break;
+      case '"': parse_string(); break;
+      case 't': parse_literal("true", NODE_TRUE); break;
+      case 'f': parse_literal("false", NODE_FALSE); break;
+      case 'n': parse_literal("null", NODE_NULL); break;
+      default:
+        if (s_[i_] == '-' || (s_[i_] >= '0' && s_[i_] <= '9')) {
+          parse_number();
+        } else {
+          fail("unexpected character");
+        }
+    }
+  }
+
+  void parse_literal(const char* lit, NodeType type) {
+    std::size_t len = std::strlen(lit);
+    if (n_ - i_ < len || std::memcmp(s_ + i_, lit, len) != 0) {
+      fail("invalid literal");
+    }
+    push(type, i_, len, 0);
+    i_ += len;
+  }
+
+  // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  void parse_number() {
+    std::size_t start = i_;
+    bool is_int = true;
+    if (s_[i_] == '-') {
+      ++i_;
+    }
+    std::size_t int_start = i_;
+    if (i_ < n_ && s_[i_] == '0') {
+      ++i_;
+    } else if (i_ < n_ && s_[i_] >= '1' && s_[i_] <= '9') {
+      while (i_ < n_ && s_[i_] >= '0' && s_[i_] <= '9') ++i_;
+    } else {
+      fail("invalid number");
+    }
+    // integers which don't fit into R integer are stored as doubles
+    std::size_t int_len = i_ - int_start;
+    if (int_len > 10 || (int_len == 10 && std::strtoll(std::string(s_ + int_start, int_len).c_str(), NULL, 10) > 2147483647LL)) {
+      is_int = false;
+    }
+    if (i_ < n_ && s_[i_] == '.') {
+      is_int = false;
+      ++i_;
+      std::size_t frac_start = i_;
+      while (i_ < n_ && s_[i_] >= '0' && s_[i_] <= '9') ++i_;
+      if (i_ == frac_start) {
+        fail("invalid number");
+      }
+    }
+    if (i_ < n_ && (s_[i_] == 'e' || s_[i_] == 'E')) {
+      is_int = false;
+      ++i_;
+      if (i_ < n_ && (s_[i_] == '+' || s_[i_] == '-')) ++i_;
+      std::size_t exp_start = i_;
+      while (i_ < n_ && s_[i_] >= '0' && s_[i_] <= '9') ++i_;
+      if (i_ == exp_start) {
+        fail("invalid number");
+      }
+    }
+    push(is_int ? NODE_INT : NODE_DBL, start, i_ - start, 0);
+  }
+
+  // validates one UTF-8 encoded character at i_, advances past it
+  void take_utf8() {
+    unsigned char c = static_cast<unsigned char>(s_[i_]);
+    std::size_t len;
+    uint32_t cp;
+    if (c >= 0xC2 && c <= 0xDF) {
+      len = 2;
+      cp = c & 0x1F;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+      len = 3;
+      cp = c & 0x0F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+      len = 4;
+      cp = c & 0x07;
+    } else {
+      fail("invalid UTF-8 sequence");
+    }
+    if (n_ - i_ < len) {
+      fail("invalid UTF-8 sequence");
+    }
+    for (std::size_t k = 1; k < len; ++k) {
+      unsigned char cc = static_cast<unsigned char>(s_[i_ + k]);
+      if ((cc & 0xC0) != 0x80) {
+        fail("invalid UTF-8 sequence");
+      }
+      cp = (cp << 6) | (cc & 0x3F);
+    }
+    // overlong encodings, surrogates and code points above U+10FFFF
+    if ((len == 3 && cp < 0x800) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+        (cp >= 0xD800 && cp <= 0xDFFF)) {
+      fail("invalid UTF-8 sequence");
+    }
+    i_ += len;
+  }
+
+  uint32_t take_hex4() {
+    if (n_ - i_ < 4) {
+      fail("invalid unicode escape");
+    }
+    uint32_t cp = 0;
+    for (int k = 0; k < 4; ++k) {
+      int h = hex_value(s_[i_ + k]);
+      if (h < 0) {
+        fail("invalid unicode escape");
+      }
+      cp = (cp << 4) | h;
+    }
+    i_ += 4;
+    return cp;
+  }
+
+  void take_escape() {
+    // i_ points to the character after '\\'
+    if (i_ == n_) {
+      fail("unexpected end of input");
+    }
+    switch (s_[i_]) {
+      case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+        ++i_;
+        return;
+      case 'u': {
+        // errors point to the start of the escape sequence
+        std::size_t start = i_ - 1;
+        ++i_;
+        uint32_t cp = take_hex4();
+        if (cp == 0) {
+          i_ = start;
+          fail("\\u0000 is not supported in R strings");
+        }
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+          if (n_ - i_ < 2 || s_[i_] != '\\' || s_[i_ + 1] != 'u') {
+            i_ = start;
+            fail("unpaired surrogate in unicode escape");
+          }
+          i_ += 2;
+          uint32_t low = take_hex4();
+          if (low < 0xDC00 || low > 0xDFFF) {
+            i_ = start;
+            fail("unpaired surrogate in unicode escape");
+          }
+        } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+          i_ = start;
+          fail("unpaired surrogate in unicode escape");
+        }
+        return;
+      }
+      default:
+        fail("invalid escape sequence");
+    }
+  }
+
+  std::size_t parse_string() {
+    // i_ points to the opening quote
+    ++i_;
+    std::size_t start = i_;
+    uint8_t flags = 0;
+    while (true) {
+      // skip plain ASCII 8 bytes at a time
+      while (n_ - i_ >= 8) {
+        uint64_t block;
+        std::memcpy(&block, s_ + i_, 8);
+        if (string_special8(block)) {
+          break;
+        }
+        i_ += 8;
+      }
+      if (i_ == n_) {
+        fail("unterminated string");
+      }
+      unsigned char c = static_cast<unsigned char>(s_[i_]);
+      if (c == '"') {
+        break;
+      } else if (c == '\\') {
+        flags |= STR_ESCAPED;
+        ++i_;
+        take_escape();
+      } else if (c < 0x20) {
+        fail("control character in string");
+      } else if (c >= 0x80) {
+        take_utf8();
+      } else {
+        ++i_;
+      }
+    }
+    std::size_t len = i_ - start;
+    ++i_;
+    // jsonlite converts these strings in arrays of numbers
+    if (!(flags & STR_ESCAPED)) {
+      if (len == 2 && std::memcmp(s_ + start, "NA", 2) == 0) {
+        flags |= STR_NA;
+      } else if ((len == 3 && (std::memcmp(s_ + start, "NaN", 3) == 0 || std::memcmp(s_ + start, "Inf", 3) == 0)) ||
+                 (len == 4 && std::memcmp(s_ + start, "-Inf", 4) == 0)) {
+        flags |= STR_NUM;
+      }
+    }
+    return push(NODE_STR, start, len, flags);
+  }
+
+  static uint8_t element_kind(const JsonNode& node) {
+    switch (node.type) {
+      case NODE_NULL: return HAS_NULL;
+      case NODE_TRUE: case NODE_FALSE: return HAS_LGL;
+      case NODE_INT: return HAS_INT;
+      case NODE_DBL: return HAS_DBL;
+      case NODE_STR:
+        if (node.flags & STR_NA) return HAS_NA_STR;
+        if (node.flags & STR_NUM) return HAS_NUM_STR;
+        return HAS_STR;
+      default: return HAS_CONTAINER;
+    }
+  }
+
+  void check_depth(std::size_t depth) {
+    if (depth > max_depth) {
+      fail("maximum nesting depth exceeded");
+    }
+  }
+
+  void parse_array(std::size_t depth) {
+    check_depth(depth);
+    std::size_t idx = push(NODE_ARR, i_, 0, 0);
+    ++i_;
+    skip_ws();
+    uint32_t count = 0;
+    uint8_t flags = 0;
+    if (i_ < n_ && s_[i_] == ']') {
+      ++i_;
+    } else {
+      while (true) {
+        std::size_t child = tape_.size();
+        parse_value(depth);
+        flags |= element_kind(tape_[child]);
+        ++count;
+        skip_ws();
+        if (i_ == n_) {
+          fail("unexpected end of input");
+        }
+        if (s_[i_] == ',') {
+          ++i_;
+          skip_ws();
+        } else if (s_[i_] == ']') {
+          ++i_;
+          break;
+        } else {
+          fail("expected ',' or ']'");
+        }
+      }
+    }
+    tape_[idx].len = count;
+    tape_[idx].flags = flags;
+    tape_[idx].next = static_cast<uint32_t>(tape_.size());
+  }
+
+  void parse_object(std::size_t depth) {
+    check_depth(depth);
+    std::size_t idx = push(NODE_OBJ, i_, 0, 0);
+    ++i_;
+    skip_ws();
+    uint32_t count = 0;
+    if (i_ < n_ && s_[i_] == '}') {
+      ++i_;
+    } else {
+      while (true) {
+        if (i_ == n_ || s_[i_] != '"') {
+          fail("expected string key");
+        }
+        parse_string();
+        skip_ws();
+        if (i_ == n_ || s_[i_] != ':') {
+          fail("expected ':'");
+        }
+        ++i_;
+        skip_ws();
+        parse_value(depth);
+        ++count;
+        skip_ws();
+        if (i_ == n_) {
+          fail("unexpected end of input");
+        }
+        if (s_[i_] == ',') {
+          ++i_;
+          skip_ws();
+        } else if (s_[i_] == '}') {
+          ++i_;
+          break;
+        } else {
+          fail("expected ',' or '}'");
+        }
+      }
+    }
+    tape_[idx].len = count;
+    tape_[idx].next = static_cast<uint32_t>(tape_.size());
+  }
+};
+
+// ---- stage 2 ----
+
+class JsonTapeReader {
+public:
+  JsonTapeReader(const char* s, const std::vector<JsonNode>& tape) : s_(s), tape_(tape) {}
+
+  SEXP read(std::size_t idx) {
+    const JsonNode& node = tape_[idx];
+    switch (node.type) {
+      case NODE_NULL: return R_NilValue;
+      case NODE_TRUE: return Rf_ScalarLogical(TRUE);
+      case NODE_FALSE: return Rf_ScalarLogical(FALSE);
+      case NODE_INT: return Rf_ScalarInteger(read_int(node));
+      case NODE_DBL: return Rf_ScalarReal(read_double(node));
+      case NODE_STR: return Rf_ScalarString(read_string(node));
+      case NODE_ARR: return read_array(idx);
+      default: return read_object(idx);
+    }
+  }
+
+private:
+  const char* s_;
+  const std::vector<JsonNode>& tape_;
+  std::string buf_;
+
+  std::size_t next(std::size_t idx) const {
+    const JsonNode& node = tape_[idx];
+    return (node.type == NODE_ARR || node.type == NODE_OBJ) ? node.next : idx + 1;
+  }
+
+  int read_int(const JsonNode& node) const {
+    const char* p = s_ + node.pos;
+    const char* end = p + node.len;
+    bool neg = *p == '-';
+    if (neg) ++p;
+    long long res = 0;
+    for (; p < end; ++p) {
+      res = res * 10 + (*p - '0');
+    }
+    // -2147483648 is NA in R
+    if (neg && res > 2147483647LL) {
+      return NA_INTEGER;
+    }
+    return static_cast<int>(neg ? -res : res);
+  }
+
+  double read_double(const JsonNode& node) const {
+    const char* p = s_ + node.pos;
+    const char* end = p + node.len;
+    // exact when the mantissa and the power of 10 are both exact doubles
+    static const double pow10[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    bool neg = *p == '-';
+    const char* q = neg ? p + 1 : p;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+    for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+      mantissa = mantissa * 10 + (*q - '0');
+      if (mantissa > 0) ++digits;
+    }
+    if (q < end && *q == '.') {
+      for (++q; q < end && *q >= '0' && *q <= '9'; ++q) {
+        mantissa = mantissa * 10 + (*q - '0');
+        if (mantissa > 0) ++digits;
+        --exp10;
+      }
+    }
+    if (q < end && (*q == 'e' || *q == 'E')) {
+      ++q;
+      bool exp_neg = *q == '-';
+      if (*q == '+' || *q == '-') ++q;
+      int e = 0;
+      for (; q < end && e < 100000; ++q) {
+        e = e * 10 + (*q - '0');
+      }
+      exp10 += exp_neg ? -e : e;
+      digits = q < end ? 100 : digits;
+    }
+    if (digits <= 15 && exp10 >= -22 && exp10 <= 22) {
+      double res = static_cast<double>(mantissa);
+      res = exp10 < 0 ? res / pow10[-exp10] : res * pow10[exp10];
+      return neg ? -res : res;
+    }
+    std::string tmp(s_ + node.pos, node.len);
+    return std::strtod(tmp.c_str(), NULL);
+  }
+
+  SEXP read_string(const JsonNode& node) {
+    const char* p = s_ + node.pos;
+    if (!(node.flags & STR_ESCAPED)) {
+      return Rf_mkCharLenCE(p, node.len, CE_UTF8);
+    }
+    const char* end = p + node.len;
+    buf_.clear();
+    while (p < end) {
+      const char* bs = static_cast<const char*>(std::memchr(p, '\\', end - p));
+      if (bs == NULL) {
+        buf_.append(p, end - p);
+        break;
+      }
+      buf_.append(p, bs - p);
+      p = bs + 1;
+      switch (*p) {
+        case 'b': buf_.push_back('\b'); ++p; break;
+        case 'f': buf_.push_back('\f'); ++p; break;
+        case 'n': buf_.push_back('\n'); ++p; break;
+        case 'r': buf_.push_back('\r'); ++p; break;
+        case 't': buf_.push_back('\t'); ++p; break;
+        case 'u': {
+          uint32_t cp = read_hex4(p + 1);
+          p += 5;
+          if (cp >= 0xD800 && cp <= 0xDBFF) {
+            uint32_t low = read_hex4(p + 2);
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            p += 6;
+          }
+          append_utf8(buf_, cp);
+          break;
+        }
+        default: buf_.push_back(*p); ++p;
+      }
+    }
+    return Rf_mkCharLenCE(buf_.data(), buf_.size(), CE_UTF8);
+  }
+
+  static uint32_t read_hex4(const char* p) {
+    uint32_t cp = 0;
+    for (int k = 0; k < 4; ++k) {
+      cp = (cp << 4) | hex_value(p[k]);
+    }
+    return cp;
+  }
+
+  // as.character() of a double
+  static SEXP format_double(double x) {
+    char buf[64];
+    if (x == 0) {
+      return Rf_mkChar("0");
+    }
+    // 15 significant digits, trailing zeros dropped
+    char sci[32];
+    std::snprintf(sci, sizeof(sci), "%.14e", x);
+    char* e = std::strchr(sci, 'e');
+    int exp10 = std::atoi(e + 1);
+    std::string mantissa(sci, e);
+    while (mantissa.back() == '0') mantissa.pop_back();
+    if (mantissa.back() == '.') mantissa.pop_back();
+    int sig = 0;
+    for (char c : mantissa) {
+      if (c >= '0' && c <= '9') ++sig;
+    }
+    // fixed notation is used unless it is wider than scientific
+    std::size_t sci_width = mantissa.size() + (std::abs(exp10) >= 100 ? 5 : 4);
+    int decimals = sig - 1 - exp10 > 0 ? sig - 1 - exp10 : 0;
+    std::size_t fixed_width = (x < 0 ? 1 : 0) + (exp10 >= 0 ? exp10 + 1 : 1) + (decimals > 0 ? decimals + 1 : 0);
+    if (fixed_width <= sci_width) {
+      std::snprintf(buf, sizeof(buf), "%.*f", decimals, x);
+    } else {
+      std::snprintf(buf, sizeof(buf), "%se%c%02d", mantissa.c_str(), exp10 < 0 ? '-' : '+', std::abs(exp10));
+    }
+    return Rf_mkChar(buf);
+  }
+
+  SEXP read_array(std::size_t idx) {
+    const JsonNode& node = tape_[idx];
+    R_xlen_t n = node.len;
+    uint8_t flags = node.flags;
+    std::size_t child = idx + 1;
+    // arrays with objects, arrays or nothing are not simplified
+    if (n == 0 || (flags & HAS_CONTAINER)) {
+      SEXP res = PROTECT(Rf_allocVector(VECSXP, n));
+      for (R_xlen_t i = 0; i < n; ++i) {
+        SET_VECTOR_ELT(res, i, read(child));
+        child = next(child);
+      }
+      UNPROTECT(1);
+      return res;
+    }
+    if (flags & HAS_STR) {
+      // special strings are kept as is when there are other strings
+      SEXP res = PROTECT(Rf_allocVector(STRSXP, n));
+      for (R_xlen_t i = 0; i < n; ++i, ++child) {
+        const JsonNode& el = tape_[child];
+        SEXP value;
+        switch (el.type) {
+          case NODE_NULL: value = NA_STRING; break;
+          case NODE_TRUE: value = Rf_mkChar("TRUE"); break;
+          case NODE_FALSE: value = Rf_mkChar("FALSE"); break;
+          case NODE_INT: value = Rf_mkCharLen(s_ + el.pos, el.len); break;
+          case NODE_DBL: value = format_double(read_double(el)); break;
+          default: value = read_string(el);
+        }
+        SET_STRING_ELT(res, i, value);
+      }
+      UNPROTECT(1);
+      return res;
+    }
+    if (flags & (HAS_DBL | HAS_NUM_STR)) {
+      SEXP res = Rf_allocVector(REALSXP, n);
+      double* p = REAL(res);
+      for (R_xlen_t i = 0; i < n; ++i, ++child) {
+        const JsonNode& el = tape_[child];
+        switch (el.type) {
+          case NODE_TRUE: p[i] = 1; break;
+          case NODE_FALSE: p[i] = 0; break;
+          case NODE_INT: p[i] = read_int(el); break;
+          case NODE_DBL: p[i] = read_double(el); break;
+          case NODE_STR:
+            if (el.flags & STR_NUM) {
+              p[i] = el.len == 3 ? (s_[el.pos] == 'N' ? R_NaN : R_PosInf) : R_NegInf;
+            } else {
+              p[i] = NA_REAL;
+            }
+            break;
+          default: p[i] = NA_REAL;
+        }
+      }
+      return res;
+    }
+    if (flags & HAS_INT) {
+      SEXP res = Rf_allocVector(INTSXP, n);
+      int* p = INTEGER(res);
+      for (R_xlen_t i = 0; i < n; ++i, ++child) {
+        const JsonNode& el = tape_[child];
+        switch (el.type) {
+          case NODE_TRUE: p[i] = 1; break;
+          case NODE_FALSE: p[i] = 0; break;
+          case NODE_INT: p[i] = read_int(el); break;
+          default: p[i] = NA_INTEGER;
+        }
+      }
+      return res;
+    }
+    SEXP res = Rf_allocVector(LGLSXP, n);
+    int* p = LOGICAL(res);
+    for (R_xlen_t i = 0; i < n; ++i, ++child) {
+      const JsonNode& el = tape_[child];
+      p[i] = el.type == NODE_TRUE ? TRUE : (el.type == NODE_FALSE ? FALSE : NA_LOGICAL);
+    }
+    return res;
+  }
+
+  SEXP read_object(std::size_t idx) {
+    R_xlen_t n = tape_[idx].len;
+    SEXP res = PROTECT(Rf_allocVector(VECSXP, n));
+    SEXP nms = PROTECT(Rf_allocVector(STRSXP, n));
+    std::size_t child = idx + 1;
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SET_STRING_ELT(nms, i, read_string(tape_[child]));
+      SET_VECTOR_ELT(res, i, read(child + 1));
+      child = next(child + 1);
+    }
+    Rf_setAttrib(res, R_NamesSymbol, nms);
+    UNPROTECT(2);
+    return res;
+  }
+};
+
+// 'x' - raw vector or string with JSON text, parsed without copying
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_from_json(SEXP x) {
+  const char* s;
+  std::size_t n;
+  if (TYPEOF(x) == RAWSXP) {
+    s = reinterpret_cast<const char*>(RAW(x));
+    n = Rf_xlength(x);
+  } else if (TYPEOF(x) == STRSXP && Rf_xlength(x) == 1 && STRING_ELT(x, 0) != NA_STRING) {
+    s = Rf_translateCharUTF8(STRING_ELT(x, 0));
+    n = std::strlen(s);
+  } else {
+    Rcpp::stop("'x' must be raw vector or string.");
+  }
+  if (n >= std::numeric_limits<uint32_t>::max()) {
+    Rcpp::stop("JSON input larger than 4GB is not supported.");
+  }
+  std::vector<JsonNode> tape;
+  tape.reserve(n / 8 + 16);
+  JsonTapeBuilder(s, n, tape).build();
+  return JsonTapeReader(s, tape).read(0);
+}
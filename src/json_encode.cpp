@@ -0,0 +1,395 @@
+#include <Rcpp.h>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include "utils.h"
+
+// JSON encoder for the common response bodies (lists, atomic vectors,
+// data frames). Output matches
+// jsonlite::toJSON(dataframe = 'columns', auto_unbox = unbox, null = 'null', na = 'null')
+// except that doubles are written with the shortest representation which
+// round-trips instead of 4 digits.
+// Everything else (matrices, raw, POSIXlt, classed objects, ...) is reported
+// as unsupported and encoded by jsonlite on the R side.
+
+// true if any of 8 bytes needs escaping: '"', '\\' or control character
+static inline bool needs_escape8(uint64_t x) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  const uint64_t high = 0x8080808080808080ULL;
+  uint64_t quote = x ^ (ones * '"');
+  uint64_t slash = x ^ (ones * '\\');
+  // bytes < 0x20, quote and slash become zero bytes
+  uint64_t res = ((x - ones * 0x20) | ((quote - ones) & ~quote) | ((slash - ones) & ~slash)) & ~x & high;
+  return res != 0;
+}
+
+// also used by the native log sink
+void json_write_string(std::string& out, const char* s, std::size_t n) {
+  static const char hex[] = "0123456789abcdef";
+  out.push_back('"');
+  std::size_t i = 0;
+  std::size_t start = 0;
+  while (i < n) {
+    // skip clean 8 bytes blocks at once
+    while (i + 8 <= n) {
+      uint64_t block;
+      std::memcpy(&block, s + i, 8);
+      if (needs_escape8(block)) {
+        break;
+      }
+      i += 8;
+    }
+    if (i >= n) {
+      break;
+    }
+    unsigned char c = static_cast<unsigned char>(s[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      ++i;
+      continue;
+    }
+    out.append(s + start, i - start);
+    switch (c) {
+      case '"': out.append("\\\""); break;
+      case '\\': out.append("\\\\"); break;
+      case '\n': out.append("\\n"); break;
+      case '\r': out.append("\\r"); break;
+      case '\t': out.append("\\t"); break;
+      case '\b': out.append("\\b"); break;
+      case '\f': out.append("\\f"); break;
+      default:
+        out.append("\\u00");
+        out.push_back(hex[c >> 4]);
+        out.push_back(hex[c & 0xf]);
+    }
+    ++i;
+    start = i;
+  }
+  out.append(s + start, n - start);
+  out.push_back('"');
+}
+
+static void write_string(std::string& out, SEXP x) {
+  if (x == NA_STRING) {
+    out.append("null");
+    return;
+  }
+  const char* s = Rf_translateCharUTF8(x);
+  json_write_string(out, s, std::strlen(s));
+}
+
+// shortest representation which reads back to the same value
+static void write_double(std::string& out, double x) {
+  if (!std::isfinite(x)) {
+    out.append("null");
+    return;
+  }
+  char buf[32];
+  if (x == std::floor(x) && std::fabs(x) < 1e15) {
+    std::snprintf(buf, sizeof(buf), "%.0f", x == 0 ? 0.0 : x);
+    out.append(buf);
+    return;
+  }
+  // any decimal with up to DBL_DIG (15) digits survives the round trip
+  // through a normal double, so if a representation with up to 15 digits
+  // exists, '%.15g' finds it. Subnormals have fewer significant bits and
+  // are searched from the first digit
+  int precision = std::fabs(x) < DBL_MIN ? 1 : DBL_DIG;
+  for (; precision < 17; ++precision) {
+    std::snprintf(buf, sizeof(buf), "%.*g", precision, x);
+    if (std::strtod(buf, NULL) == x) {
+      out.append(buf);
+      return;
+    }
+  }
+  std::snprintf(buf, sizeof(buf), "%.17g", x);
+  out.append(buf);
+}
+
+static void write_int(std::string& out, int x) {
+  if (x == NA_INTEGER) {
+    out.append("null");
+    return;
+  }
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%d", x);
+  out.append(buf);
+}
+
+static void write_date(std::string& out, double x) {
+  std::int64_t y;
+  int m, d;
+  civil_from_days(static_cast<std::int64_t>(std::floor(x)), y, m, d);
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "\"%04lld-%02d-%02d\"", static_cast<long long>(y), m, d);
+  out.append(buf);
+}
+
+static bool is_class(SEXP x, const char* cls) {
+  return Rf_inherits(x, cls);
+}
+
+// only a few attributes change the output, others are ignored as in jsonlite
+static bool has_dim(SEXP x) {
+  return Rf_getAttrib(x, R_DimSymbol) != R_NilValue;
+}
+
+class JsonEncoder {
+public:
+  explicit JsonEncoder(std::string& out) : out_(out) {}
+
+  bool write(SEXP x, bool unbox) {
+    if (Rf_isNull(x)) {
+      out_.append("null");
+      return true;
+    }
+    if (has_dim(x)) {
+      return false;
+    }
+    SEXP cls = Rf_getAttrib(x, R_ClassSymbol);
+    if (cls != R_NilValue) {
+      return write_classed(x, cls, unbox);
+    }
+    if (TYPEOF(x) == VECSXP) {
+      return write_list(x, unbox);
+    }
+    return write_atomic(x, unbox);
+  }
+
+private:
+  std::string& out_;
+
+  bool write_classed(SEXP x, SEXP cls, bool unbox) {
+    if (is_class(x, "data.frame")) {
+      return Rf_length(cls) == 1 && write_data_frame(x);
+    }
+    if (is_class(x, "POSIXct")) {
+      return write_times(x, unbox);
+    }
+    if (Rf_length(cls) != 1) {
+      return false;
+    }
+    if (is_class(x, "factor")) {
+      return write_factor(x, unbox);
+    }
+    if (is_class(x, "Date")) {
+      return write_dates(x, unbox);
+    }
+    if (is_class(x, "AsIs")) {
+      return TYPEOF(x) == VECSXP ? write_list(x, false) : write_atomic(x, false);
+    }
+    return false;
+  }
+
+  void open_array(R_xlen_t n, bool unbox) {
+    if (!(unbox && n == 1)) {
+      out_.push_back('[');
+    }
+  }
+
+  void close_array(R_xlen_t n, bool unbox) {
+    if (!(unbox && n == 1)) {
+      out_.push_back(']');
+    }
+  }
+
+  bool write_atomic(SEXP x, bool unbox) {
+    R_xlen_t n = Rf_xlength(x);
+    switch (TYPEOF(x)) {
+      case LGLSXP: {
+        const int* p = LOGICAL(x);
+        open_array(n, unbox);
+        for (R_xlen_t i = 0; i < n; ++i) {
+          if (i > 0) out_.push_back(',');
+          out_.append(p[i] == NA_LOGICAL ? "null" : (p[i] ? "true" : "false"));
+        }
+        close_array(n, unbox);
+        return true;
+      }
+      case INTSXP: {
+        const int* p = INTEGER(x);
+        open_array(n, unbox);
+        for (R_xlen_t i = 0; i < n; ++i) {
+          if (i > 0) out_.push_back(',');
+          write_int(out_, p[i]);
+        }
+        close_array(n, unbox);
+        return true;
+      }
+      case REALSXP: {
+        const double* p = REAL(x);
+        open_array(n, unbox);
+        for (R_xlen_t i = 0; i < n; ++i) {
+          if (i > 0) out_.push_back(',');
+          write_double(out_, p[i]);
+        }
+        close_array(n, unbox);
+        return true;
+      }
+      case STRSXP: {
+        open_array(n, unbox);
+        for (R_xlen_t i = 0; i < n; ++i) {
+          if (i > 0) out_.push_back(',');
+          write_string(out_, STRING_ELT(x, i));
+        }
+        close_array(n, unbox);
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  bool write_factor(SEXP x, bool unbox) {
+    SEXP levels = Rf_getAttrib(x, R_LevelsSymbol);
+    if (TYPEOF(x) != INTSXP || TYPEOF(levels) != STRSXP) {
+      return false;
+    }
+    R_xlen_t n = Rf_xlength(x);
+    R_xlen_t n_levels = Rf_xlength(levels);
+    const int* p = INTEGER(x);
+    open_array(n, unbox);
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (i > 0) out_.push_back(',');
+      if (p[i] == NA_INTEGER || p[i] < 1 || p[i] > n_levels) {
+        out_.append("null");
+      } else {
+        write_string(out_, STRING_ELT(levels, p[i] - 1));
+      }
+    }
+    close_array(n, unbox);
+    return true;
+  }
+
+  bool write_dates(SEXP x, bool unbox) {
+    if (TYPEOF(x) != REALSXP && TYPEOF(x) != INTSXP) {
+      return false;
+    }
+    R_xlen_t n = Rf_xlength(x);
+    open_array(n, unbox);
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (i > 0) out_.push_back(',');
+      double value = TYPEOF(x) == REALSXP ? REAL(x)[i] :
+        (INTEGER(x)[i] == NA_INTEGER ? NA_REAL : INTEGER(x)[i]);
+      if (!std::isfinite(value)) {
+        out_.append("null");
+        continue;
+      }
+      // years 0-9999
+      if (value < -719528 || value >= 2932897) {
+        return false;
+      }
+      write_date(out_, value);
+    }
+    close_array(n, unbox);
+    return true;
+  }
+
+  // jsonlite writes times as strings formatted by R in the time zone of the
+  // object (format.POSIXct() with the default format), so R does it here too
+  bool write_times(SEXP x, bool unbox) {
+    if (TYPEOF(x) != REALSXP && TYPEOF(x) != INTSXP) {
+      return false;
+    }
+    SEXP call = PROTECT(Rf_lang2(Rf_install("format"), x));
+    int err = 0;
+    SEXP res = PROTECT(R_tryEvalSilent(call, R_BaseEnv, &err));
+    if (err || TYPEOF(res) != STRSXP || Rf_xlength(res) != Rf_xlength(x)) {
+      UNPROTECT(2);
+      return false;
+    }
+    R_xlen_t n = Rf_xlength(res);
+    open_array(n, unbox);
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (i > 0) out_.push_back(',');
+      write_string(out_, STRING_ELT(res, i));
+    }
+    close_array(n, unbox);
+    UNPROTECT(2);
+    return true;
+  }
+
+  // names of the object keys, empty names are replaced by index as in jsonlite
+  bool write_key(SEXP names, R_xlen_t i, std::unordered_set<std::string>& seen) {
+    SEXP el = STRING_ELT(names, i);
+    std::string key = (el == NA_STRING || LENGTH(el) == 0) ?
+      std::to_string(i + 1) : std::string(Rf_translateCharUTF8(el));
+    if (!seen.insert(key).second) {
+      return false;
+    }
+    json_write_string(out_, key.data(), key.size());
+    out_.push_back(':');
+    return true;
+  }
+
+  bool write_list(SEXP x, bool unbox) {
+    R_xlen_t n = Rf_xlength(x);
+    SEXP names = Rf_getAttrib(x, R_NamesSymbol);
+    if (names == R_NilValue) {
+      out_.push_back('[');
+      for (R_xlen_t i = 0; i < n; ++i) {
+        if (i > 0) out_.push_back(',');
+        if (!write(VECTOR_ELT(x, i), unbox)) {
+          return false;
+        }
+      }
+      out_.push_back(']');
+      return true;
+    }
+    std::unordered_set<std::string> seen;
+    out_.push_back('{');
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (i > 0) out_.push_back(',');
+      if (!write_key(names, i, seen) || !write(VECTOR_ELT(x, i), unbox)) {
+        return false;
+      }
+    }
+    out_.push_back('}');
+    return true;
+  }
+
+  // dataframe = 'columns': object of columns, columns are never unboxed
+  bool write_data_frame(SEXP x) {
+    if (TYPEOF(x) != VECSXP || TYPEOF(Rf_getAttrib(x, R_RowNamesSymbol)) == STRSXP) {
+      return false;
+    }
+    R_xlen_t n = Rf_xlength(x);
+    SEXP names = Rf_getAttrib(x, R_NamesSymbol);
+    if (TYPEOF(names) != STRSXP) {
+      return false;
+    }
+    std::unordered_set<std::string> seen;
+    out_.push_back('{');
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SEXP column = VECTOR_ELT(x, i);
+      if (TYPEOF(column) == VECSXP) {
+        return false;
+      }
+      if (i > 0) out_.push_back(',');
+      if (!write_key(names, i, seen) || !write(column, false)) {
+        return false;
+      }
+    }
+    out_.push_back('}');
+    return true;
+  }
+};
+
+// returns NULL if 'x' can't be encoded natively (caller falls back to jsonlite)
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_to_json(SEXP x, bool unbox = true) {
+  std::string out;
+  out.reserve(256);
+  JsonEncoder encoder(out);
+  if (!encoder.write(x, unbox)) {
+    return R_NilValue;
+  }
+  SEXP res = PROTECT(Rf_allocVector(STRSXP, 1));
+  SET_STRING_ELT(res, 0, Rf_mkCharLenCE(out.data(), out.size(), CE_UTF8));
+  UNPROTECT(1);
+  return res;
+}
@@ -0,0 +1,516 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+#include "utils.h"
+
+// Buffered log sink. Log lines are copied into a preallocated buffer and
+// written out in batches:
+// * by a background thread every 'flush_interval' seconds (or earlier when
+//   the buffer is half full), so requests don't wait for the output;
+// * synchronously when the buffer is full;
+// * before fork() - children don't inherit pending lines of the parent;
+// * on process exit (including forked children which exit with exit()).
+// The background thread never touches R API. On Windows there is no
+// background thread and lines are written when the buffer is full or on exit.
+
+#ifndef _WIN32
+class Mutex {
+public:
+  Mutex() { pthread_mutex_init(&mu_, NULL); }
+  ~Mutex() { pthread_mutex_destroy(&mu_); }
+  void lock() { pthread_mutex_lock(&mu_); }
+  void unlock() { pthread_mutex_unlock(&mu_); }
+  pthread_mutex_t* native() { return &mu_; }
+private:
+  pthread_mutex_t mu_;
+};
+#else
+class Mutex {
+public:
+  void lock() {}
+  void unlock() {}
+};
+#endif
+
+class MutexLock {
+public:
+  explicit MutexLock(Mutex& mu) : mu_(mu) { mu_.lock(); }
+  ~MutexLock() { mu_.unlock(); }
+private:
+  Mutex& mu_;
+};
+
+enum class SinkTarget { STDOUT, FILE, SOCKET };
+
+class LogSink {
+public:
+  LogSink(SinkTarget target, const std::string& path, std::size_t capacity,
+          double flush_interval, double max_size, int max_files)
+    : target_(target), path_(path), capacity_(capacity),
+      flush_interval_(flush_interval), max_size_(max_size), max_files_(max_files) {
+    buf_.resize(capacity_);
+    pending_.resize(capacity_);
+#ifndef _WIN32
+    pthread_cond_init(&cv_, NULL);
+#endif
+    open();
+  }
+
+  ~LogSink() {
+    stop_thread();
+    flush();
+    close();
+#ifndef _WIN32
+    pthread_cond_destroy(&cv_);
+#endif
+  }
+
+  void write(const char* p, std::size_t n) {
+    start_thread();
+    if (append(p, n)) {
+      return;
+    }
+    // buffer is full
+    flush();
+    if (n > capacity_) {
+      MutexLock io(io_mu_);
+      write_out(p, n);
+      return;
+    }
+    append(p, n);
+  }
+
+  // writes out everything buffered so far
+  void flush() {
+    MutexLock io(io_mu_);
+    std::size_t n;
+    {
+      MutexLock lock(mu_);
+      std::swap(buf_, pending_);
+      n = used_;
+      used_ = 0;
+    }
+    if (n > 0) {
+      write_out(pending_.data(), n);
+    }
+  }
+
+#ifndef _WIN32
+  // fork() handlers: nothing is pending and no lock is held by the other
+  // thread at the moment of fork
+  void before_fork() {
+    flush();
+    io_mu_.lock();
+    mu_.lock();
+  }
+  void after_fork_parent() {
+    mu_.unlock();
+    io_mu_.unlock();
+  }
+  void after_fork_child() {
+    // locks were taken by the thread which called fork(), which is the only
+    // thread of the child, so they are released as in the parent
+    mu_.unlock();
+    io_mu_.unlock();
+    // 'cv_' may still record the background thread of the parent as a
+    // waiter, it has no waiters in the child and is created again
+    pthread_cond_init(&cv_, NULL);
+    // background thread is not copied by fork()
+    thread_running_ = false;
+  }
+#endif
+
+private:
+  SinkTarget target_;
+  std::string path_;
+  std::size_t capacity_;
+  double flush_interval_;
+  double max_size_;
+  int max_files_;
+  int fd_ = -1;
+  // 'buf_' is filled by writers under 'mu_', 'pending_' is written out
+  // under 'io_mu_' (always taken before 'mu_')
+  std::vector<char> buf_;
+  std::vector<char> pending_;
+  std::size_t used_ = 0;
+  Mutex mu_;
+  Mutex io_mu_;
+#ifndef _WIN32
+  pthread_cond_t cv_;
+  pthread_t thread_;
+#endif
+  bool thread_running_ = false;
+  bool stop_ = false;
+
+  // returns false if line doesn't fit into the buffer
+  bool append(const char* p, std::size_t n) {
+    MutexLock lock(mu_);
+    if (used_ + n > capacity_) {
+      return false;
+    }
+    std::memcpy(buf_.data() + used_, p, n);
+    used_ += n;
+#ifndef _WIN32
+    if (used_ >= capacity_ / 2) {
+      pthread_cond_signal(&cv_);
+    }
+#endif
+    return true;
+  }
+
+#ifndef _WIN32
+  static void* run(void* arg) {
+    static_cast<LogSink*>(arg)->loop();
+    return NULL;
+  }
+
+  void loop() {
+    mu_.lock();
+    while (!stop_) {
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      double deadline = now.tv_sec + now.tv_usec * 1e-6 + flush_interval_;
+      struct timespec ts;
+      ts.tv_sec = static_cast<time_t>(deadline);
+      ts.tv_nsec = static_cast<long>((deadline - std::floor(deadline)) * 1e9);
+      pthread_cond_timedwait(&cv_, mu_.native(), &ts);
+      if (stop_ || used_ == 0) {
+        continue;
+      }
+      mu_.unlock();
+      flush();
+      mu_.lock();
+    }
+    mu_.unlock();
+  }
+
+  void start_thread() {
+    if (thread_running_ || flush_interval_ <= 0) {
+      return;
+    }
+    stop_ = false;
+    thread_running_ = pthread_create(&thread_, NULL, &LogSink::run, this) == 0;
+  }
+
+  void stop_thread() {
+    if (!thread_running_) {
+      return;
+    }
+    {
+      MutexLock lock(mu_);
+      stop_ = true;
+      pthread_cond_signal(&cv_);
+    }
+    pthread_join(thread_, NULL);
+    thread_running_ = false;
+  }
+#else
+  void start_thread() {}
+  void stop_thread() {}
+#endif
+
+  void open() {
+    if (target_ == SinkTarget::FILE) {
+      fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if (fd_ < 0) {
+        Rcpp::stop("Can't open log file '%s': %s.", path_, std::strerror(errno));
+      }
+    } else if (target_ == SinkTarget::SOCKET) {
+#ifndef _WIN32
+      fd_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+      if (fd_ < 0) {
+        Rcpp::stop("Can't create socket: %s.", std::strerror(errno));
+      }
+      connect_socket();
+#else
+      Rcpp::stop("Unix sockets are not supported on Windows.");
+#endif
+    }
+  }
+
+  void close() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+#ifndef _WIN32
+  // receiver might be started later, connection is retried on each write
+  bool connect_socket() {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+    return connect(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0;
+  }
+#endif
+
+  static void write_fd(int fd, const char* p, std::size_t n) {
+    while (n > 0) {
+      ssize_t res = ::write(fd, p, n);
+      if (res < 0) {
+        if (errno == EINTR) continue;
+        return;
+      }
+      p += res;
+      n -= res;
+    }
+  }
+
+  // other processes might rotate the file as well, so the file is checked
+  // by name and reopened if it was replaced
+  void rotate(std::size_t incoming) {
+    if (!std::isfinite(max_size_)) {
+      return;
+    }
+    struct stat by_name, by_fd;
+    if (stat(path_.c_str(), &by_name) != 0 || fstat(fd_, &by_fd) != 0 ||
+        by_name.st_ino != by_fd.st_ino || by_name.st_dev != by_fd.st_dev) {
+      close();
+      fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if (fd_ < 0 || fstat(fd_, &by_name) != 0) {
+        return;
+      }
+    }
+    if (by_name.st_size == 0 || by_name.st_size + static_cast<double>(incoming) <= max_size_) {
+      return;
+    }
+    // 'path.(k)' -> 'path.(k + 1)', 'path' -> 'path.1'
+    for (int k = max_files_ - 1; k >= 1; --k) {
+      std::string from = path_ + "." + std::to_string(k);
+      std::string to = path_ + "." + std::to_string(k + 1);
+      std::rename(from.c_str(), to.c_str());
+    }
+    if (max_files_ > 0) {
+      std::string to = path_ + ".1";
+      std::rename(path_.c_str(), to.c_str());
+    } else {
+      std::remove(path_.c_str());
+    }
+    close();
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  }
+
+  void write_out(const char* p, std::size_t n) {
+    switch (target_) {
+      case SinkTarget::STDOUT:
+        // keep order with output already buffered by stdio
+        std::fflush(stdout);
+        write_fd(STDOUT_FILENO, p, n);
+        break;
+      case SinkTarget::FILE:
+        rotate(n);
+        if (fd_ >= 0) {
+          write_fd(fd_, p, n);
+        }
+        break;
+      case SinkTarget::SOCKET:
+#ifndef _WIN32
+        // one datagram per line, lines are dropped if nobody listens
+        while (n > 0) {
+          const char* end = static_cast<const char*>(std::memchr(p, '\n', n));
+          std::size_t len = end == NULL ? n : end - p + 1;
+          if (send(fd_, p, len - (end == NULL ? 0 : 1), 0) < 0 &&
+              (errno == ENOTCONN || errno == ECONNREFUSED || errno == EDESTADDRREQ) &&
+              connect_socket()) {
+            send(fd_, p, len - (end == NULL ? 0 : 1), 0);
+          }
+          p += len;
+          n -= len;
+        }
+#endif
+        break;
+    }
+  }
+};
+
+// all live sinks are flushed before fork() and on exit
+static std::vector<LogSink*> log_sinks;
+
+static void flush_log_sinks() {
+  for (LogSink* sink : log_sinks) {
+    sink->flush();
+  }
+}
+
+#ifndef _WIN32
+static void log_sinks_before_fork() {
+  for (LogSink* sink : log_sinks) {
+    sink->before_fork();
+  }
+}
+static void log_sinks_after_fork_parent() {
+  for (LogSink* sink : log_sinks) {
+    sink->after_fork_parent();
+  }
+}
+static void log_sinks_after_fork_child() {
+  for (LogSink* sink : log_sinks) {
+    sink->after_fork_child();
+  }
+}
+#endif
+
+static void register_log_sink(LogSink* sink) {
+  static bool handlers_registered = false;
+  if (!handlers_registered) {
+    std::atexit(flush_log_sinks);
+#ifndef _WIN32
+    pthread_atfork(log_sinks_before_fork, log_sinks_after_fork_parent, log_sinks_after_fork_child);
+#endif
+    handlers_registered = true;
+  }
+  log_sinks.push_back(sink);
+}
+
+static void log_sink_finalizer(SEXP ptr) {
+  LogSink* sink = static_cast<LogSink*>(R_ExternalPtrAddr(ptr));
+  if (sink != nullptr) {
+    log_sinks.erase(std::remove(log_sinks.begin(), log_sinks.end(), sink), log_sinks.end());
+    delete sink;
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+static LogSink* get_sink(SEXP ptr) {
+  if (TYPEOF(ptr) != EXTPTRSXP || R_ExternalPtrAddr(ptr) == nullptr) {
+    Rcpp::stop("Log sink is not initialized.");
+  }
+  return static_cast<LogSink*>(R_ExternalPtrAddr(ptr));
+}
+
+// same as format(x, "%Y-%m-%d %H:%M:%OS6") in the local time zone
+// (fractional seconds are truncated), formatted seconds are cached
+static void write_timestamp(std::string& out, double x) {
+  static long cached_secs = LONG_MIN;
+  static char cached[64];
+  double secs = std::floor(x);
+  int usecs = static_cast<int>((x - secs) * 1e6);
+  if (usecs > 999999) usecs = 999999;
+  if (static_cast<long>(secs) != cached_secs) {
+    time_t t = static_cast<time_t>(secs);
+    struct tm tm;
+    tzset();
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    std::strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm);
+    cached_secs = static_cast<long>(secs);
+  }
+  char frac[16];
+  std::snprintf(frac, sizeof(frac), ".%06d", usecs);
+  out.append(cached);
+  out.append(frac);
+}
+
+static void write_json_scalar(std::string& out, SEXP x) {
+  SEXP el = STRING_ELT(x, 0);
+  if (el == NA_STRING) {
+    out.append("null");
+    return;
+  }
+  const char* s = Rf_translateCharUTF8(el);
+  json_write_string(out, s, std::strlen(s));
+}
+
+// 'target' is one of "stdout", "file", "socket"
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_log_sink_new(const std::string& target, const std::string& path,
+                      double buffer_size = 65536, double flush_interval = 1,
+                      double max_size = R_PosInf, int max_files = 5) {
+  SinkTarget type;
+  if (target == "stdout") {
+    type = SinkTarget::STDOUT;
+  } else if (target == "file") {
+    type = SinkTarget::FILE;
+  } else if (target == "socket") {
+    type = SinkTarget::SOCKET;
+  } else {
+    Rcpp::stop("unknown log sink target '%s'.", target);
+  }
+  if (!(buffer_size >= 1) || buffer_size > INT_MAX) {
+    Rcpp::stop("'buffer_size' must be a positive number.");
+  }
+  std::string full_path = path.empty() ? path : std::string(R_ExpandFileName(path.c_str()));
+  LogSink* sink = new LogSink(type, full_path, static_cast<std::size_t>(buffer_size),
+                              flush_interval, max_size, max_files);
+  register_log_sink(sink);
+  SEXP ptr = PROTECT(R_MakeExternalPtr(sink, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, log_sink_finalizer, TRUE);
+  UNPROTECT(1);
+  return ptr;
+}
+
+// writes already formatted line, '\n' is appended
+// [[Rcpp::export(rng=false)]]
+void cpp_log_sink_write(SEXP ptr, SEXP line) {
+  LogSink* sink = get_sink(ptr);
+  if (TYPEOF(line) != STRSXP || Rf_xlength(line) != 1 || STRING_ELT(line, 0) == NA_STRING) {
+    Rcpp::stop("'line' must be a string.");
+  }
+  std::string x(CHAR(STRING_ELT(line, 0)), LENGTH(STRING_ELT(line, 0)));
+  x.push_back('\n');
+  sink->write(x.data(), x.size());
+}
+
+// writes log entry in the same format as the default Logger printer:
+// {"timestamp":...,"level":...,"name":...,"pid":...,"msg":...,<extra>}
+// 'extra' is NULL or JSON object with additional fields
+// [[Rcpp::export(rng=false)]]
+void cpp_log_sink_entry(SEXP ptr, double timestamp, SEXP level, SEXP name, int pid,
+                        SEXP msg, SEXP extra) {
+  LogSink* sink = get_sink(ptr);
+  if (TYPEOF(level) != STRSXP || TYPEOF(name) != STRSXP || TYPEOF(msg) != STRSXP ||
+      Rf_xlength(level) != 1 || Rf_xlength(name) != 1 || Rf_xlength(msg) != 1) {
+    Rcpp::stop("'level', 'name' and 'msg' must be strings.");
+  }
+  std::string out;
+  out.reserve(256);
+  out.append("{\"timestamp\":\"");
+  write_timestamp(out, timestamp);
+  out.append("\",\"level\":");
+  write_json_scalar(out, level);
+  out.append(",\"name\":");
+  write_json_scalar(out, name);
+  out.append(",\"pid\":");
+  out.append(pid == NA_INTEGER ? "null" : std::to_string(pid));
+  out.append(",\"msg\":");
+  write_json_scalar(out, msg);
+  if (TYPEOF(extra) == STRSXP && Rf_xlength(extra) == 1 && STRING_ELT(extra, 0) != NA_STRING) {
+    SEXP el = STRING_ELT(extra, 0);
+    const char* p = CHAR(el);
+    std::size_t n = LENGTH(el);
+    // strip '{' and '}' of the object
+    if (n > 2 && p[0] == '{' && p[n - 1] == '}') {
+      out.push_back(',');
+      out.append(p + 1, n - 2);
+    }
+  }
+  out.append("}\n");
+  sink->write(out.data(), out.size());
+}
+
+// [[Rcpp::export(rng=false)]]
+void cpp_log_sink_flush(SEXP ptr) {
+  get_sink(ptr)->flush();
+}
@@ -0,0 +1,424 @@
+#include <Rcpp.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+// see https://datatracker.ietf.org/doc/html/rfc7231#section-3.1.1.1
+// and https://datatracker.ietf.org/doc/html/rfc7231#section-5.3.2
+struct MediaType {
+  std::string type;
+  std::string subtype;
+  std::vector<std::pair<std::string, std::string>> params;
+  double q = 1;
+};
+
+// parsed values are cached per distinct header string for the life of the process
+// (cache is dropped when it becomes too large - header values are controlled by clients)
+class MediaTypeCache {
+public:
+  SEXP get(const std::string& key) const {
+    auto it = cache_.find(key);
+    return it == cache_.end() ? R_NilValue : it->second;
+  }
+  void set(const std::string& key, SEXP value) {
+    if (cache_.size() >= max_size) {
+      clear();
+    }
+    R_PreserveObject(value);
+    MARK_NOT_MUTABLE(value);
+    cache_.emplace(key, value);
+  }
+  void clear() {
+    for (auto& x : cache_) {
+      R_ReleaseObject(x.second);
+    }
+    cache_.clear();
+  }
+private:
+  static const std::size_t max_size = 1024;
+  std::unordered_map<std::string, SEXP> cache_;
+};
+
+static MediaTypeCache media_type_cache;
+static MediaTypeCache accept_cache;
+
+static std::string lower(sv x) {
+  std::string res(x.data(), x.size());
+  str_lower(res);
+  return res;
+}
+
+static void skip_ows(sv& x) {
+  while (!x.empty() && (x.front() == ' ' || x.front() == '\t')) {
+    x.remove_prefix(1);
+  }
+}
+
+static sv take_token(sv& x) {
+  std::size_t n = 0;
+  while (n < x.size() && is_tchar(x[n])) {
+    ++n;
+  }
+  sv res = x.substr(0, n);
+  x.remove_prefix(n);
+  return res;
+}
+
+// token or quoted-string (with backslash escapes)
+static bool take_param_value(sv& x, std::string& out) {
+  out.clear();
+  if (x.empty() || x.front() != '"') {
+    sv token = take_token(x);
+    out.assign(token.data(), token.size());
+    return !token.empty();
+  }
+  x.remove_prefix(1);
+  while (!x.empty()) {
+    char c = x.front();
+    x.remove_prefix(1);
+    if (c == '"') {
+      return true;
+    }
+    if (c == '\\' && !x.empty()) {
+      c = x.front();
+      x.remove_prefix(1);
+    }
+    out.push_back(c);
+  }
+  // no closing quote
+  return false;
+}
+
+static bool parse_qvalue(const std::string& x, double& q) {
+  char* end;
+  q = std::strtod(x.c_str(), &end);
+  return end != x.c_str() && *end == '\0' && q >= 0 && q <= 1;
+}
+
+// parses single media type (range) with parameters
+// 'x' should not contain other media ranges ('a/b;q=1, c/d')
+static bool parse_media_type(sv x, bool accept, MediaType& res) {
+  x = sv_trim(x);
+  sv type = take_token(x);
+  if (type.empty() || x.empty() || x.front() != '/') {
+    return false;
+  }
+  x.remove_prefix(1);
+  sv subtype = take_token(x);
+  if (subtype.empty()) {
+    return false;
+  }
+  res.type = lower(type);
+  res.subtype = lower(subtype);
+  res.params.clear();
+  res.q = 1;
+  // wildcard type only with wildcard subtype
+  if (res.type == "*" && res.subtype != "*") {
+    return false;
+  }
+  std::string value;
+  while (true) {
+    skip_ows(x);
+    if (x.empty()) {
+      return true;
+    }
+    if (x.front() != ';') {
+      return false;
+    }
+    x.remove_prefix(1);
+    skip_ows(x);
+    // allow trailing ';'
+    if (x.empty()) {
+      return true;
+    }
+    sv name = take_token(x);
+    if (name.empty() || x.empty() || x.front() != '=') {
+      return false;
+    }
+    x.remove_prefix(1);
+    if (!take_param_value(x, value)) {
+      return false;
+    }
+    std::string name_lower = lower(name);
+    if (accept && name_lower == "q") {
+      if (!parse_qvalue(value, res.q)) {
+        return false;
+      }
+      // accept-ext parameters after weight are ignored
+      return true;
+    }
+    res.params.emplace_back(std::move(name_lower), value);
+  }
+}
+
+// splits by commas which are not inside quoted strings
+static void split_media_ranges(sv x, std::vector<sv>& out) {
+  bool quoted = false;
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    char c = x[i];
+    if (quoted && c == '\\') {
+      ++i;
+    } else if (c == '"') {
+      quoted = !quoted;
+    } else if (c == ',' && !quoted) {
+      out.push_back(x.substr(start, i - start));
+      start = i + 1;
+    }
+  }
+  out.push_back(x.substr(start));
+}
+
+// header might be split by commas already (see RestRserve.headers.split option)
+static std::string join_header(SEXP x) {
+  std::string res;
+  R_xlen_t n = Rf_xlength(x);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP el = STRING_ELT(x, i);
+    if (el == NA_STRING) {
+      continue;
+    }
+    if (!res.empty()) {
+      res.push_back(',');
+    }
+    res.append(CHAR(el), LENGTH(el));
+  }
+  return res;
+}
+
+static SEXP mkstr(const std::string& x) {
+  return Rf_mkCharLen(x.data(), x.size());
+}
+
+static SEXP make_params(const MediaType& x) {
+  std::size_t n = x.params.size();
+  Rcpp::CharacterVector res(n);
+  Rcpp::CharacterVector res_names(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    SET_STRING_ELT(res_names, i, mkstr(x.params[i].first));
+    SET_STRING_ELT(res, i, mkstr(x.params[i].second));
+  }
+  res.names() = res_names;
+  return res;
+}
+
+static void parse_accept(const std::string& header, std::vector<MediaType>& res) {
+  std::vector<sv> ranges;
+  split_media_ranges(header, ranges);
+  MediaType mt;
+  for (const sv& range : ranges) {
+    // invalid and empty elements are ignored
+    if (parse_media_type(range, true, mt)) {
+      res.push_back(mt);
+    }
+  }
+}
+
+// parsed Accept header - vector of the media ranges in order of appearance
+static SEXP parse_accept_cached(SEXP x) {
+  std::string header = join_header(x);
+  SEXP cached = accept_cache.get(header);
+  if (!Rf_isNull(cached)) {
+    return cached;
+  }
+  std::vector<MediaType> ranges;
+  parse_accept(header, ranges);
+  std::size_t n = ranges.size();
+  Rcpp::CharacterVector type(n), subtype(n);
+  Rcpp::NumericVector q(n);
+  Rcpp::List params(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    SET_STRING_ELT(type, i, mkstr(ranges[i].type));
+    SET_STRING_ELT(subtype, i, mkstr(ranges[i].subtype));
+    q[i] = ranges[i].q;
+    params[i] = make_params(ranges[i]);
+  }
+  Rcpp::List res = Rcpp::List::create(
+    Rcpp::Named("type") = type,
+    Rcpp::Named("subtype") = subtype,
+    Rcpp::Named("q") = q,
+    Rcpp::Named("params") = params
+  );
+  accept_cache.set(header, res);
+  return res;
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_parse_media_type(SEXP x) {
+  if (TYPEOF(x) != STRSXP || Rf_xlength(x) != 1 || STRING_ELT(x, 0) == NA_STRING) {
+    Rcpp::stop("'x' must be a string.");
+  }
+  std::string key(CHAR(STRING_ELT(x, 0)));
+  SEXP cached = media_type_cache.get(key);
+  if (!Rf_isNull(cached)) {
+    return cached;
+  }
+  MediaType mt;
+  if (!parse_media_type(key, false, mt)) {
+    return R_NilValue;
+  }
+  Rcpp::List res = Rcpp::List::create(
+    Rcpp::Named("type") = mt.type,
+    Rcpp::Named("subtype") = mt.subtype,
+    Rcpp::Named("essence") = mt.type + "/" + mt.subtype,
+    Rcpp::Named("params") = make_params(mt)
+  );
+  media_type_cache.set(key, res);
+  return res;
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_parse_accept(SEXP x) {
+  if (!Rf_isNull(x) && TYPEOF(x) != STRSXP) {
+    Rcpp::stop("'x' must be character vector.");
+  }
+  return parse_accept_cached(x);
+}
+
+// returns 1-based index of the 'available' media type with the highest quality
+// according to the Accept header (ties resolved by order of 'available')
+// or NA if none of them is acceptable
+// see https://datatracker.ietf.org/doc/html/rfc7231#section-5.3.2
+// [[Rcpp::export(rng=false)]]
+int cpp_negotiate_media_type(SEXP accept, Rcpp::CharacterVector available) {
+  if (!Rf_isNull(accept) && TYPEOF(accept) != STRSXP) {
+    Rcpp::stop("'accept' must be character vector.");
+  }
+  R_xlen_t n = available.size();
+  // no Accept header - any media type is acceptable
+  if (Rf_xlength(accept) == 0) {
+    return n > 0 ? 1 : NA_INTEGER;
+  }
+  SEXP ranges = parse_accept_cached(accept);
+  SEXP range_type = VECTOR_ELT(ranges, 0);
+  SEXP range_subtype = VECTOR_ELT(ranges, 1);
+  const double* range_q = REAL(VECTOR_ELT(ranges, 2));
+  R_xlen_t n_ranges = Rf_xlength(range_type);
+
+  int best = NA_INTEGER;
+  double best_q = 0;
+  MediaType mt;
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP el = STRING_ELT(available, i);
+    if (el == NA_STRING || !parse_media_type(sv(CHAR(el), LENGTH(el)), false, mt)) {
+      continue;
+    }
+    // quality of the most specific matching range
+    int specificity = 0;
+    double q = 0;
+    for (R_xlen_t j = 0; j < n_ranges; ++j) {
+      const char* type = CHAR(STRING_ELT(range_type, j));
+      const char* subtype = CHAR(STRING_ELT(range_subtype, j));
+      int s = 0;
+      if (mt.type == type && mt.subtype == subtype) {
+        s = 3;
+      } else if (mt.type == type && std::strcmp(subtype, "*") == 0) {
+        s = 2;
+      } else if (std::strcmp(type, "*") == 0) {
+        s = 1;
+      }
+      if (s > specificity) {
+        specificity = s;
+        q = range_q[j];
+      }
+    }
+    if (q > best_q) {
+      best_q = q;
+      best = i + 1;
+    }
+  }
+  return best;
+}
+
+// 'x-gzip' is an alias of 'gzip' (RFC 7230 section 4.2.3)
+static std::string normalize_coding(sv x) {
+  std::string res = lower(x);
+  if (res == "x-gzip") {
+    res = "gzip";
+  }
+  return res;
+}
+
+// returns 1-based index of the 'available' content coding with the highest
+// quality according to the Accept-Encoding header (ties resolved by order of
+// 'available') or NA if only identity is acceptable.
+// No header means that the client didn't ask for compression.
+// see https://datatracker.ietf.org/doc/html/rfc7231#section-5.3.4
+// [[Rcpp::export(rng=false)]]
+int cpp_negotiate_encoding(SEXP accept_encoding, Rcpp::CharacterVector available) {
+  if (!Rf_isNull(accept_encoding) && TYPEOF(accept_encoding) != STRSXP) {
+    Rcpp::stop("'accept_encoding' must be character vector.");
+  }
+  R_xlen_t n = available.size();
+  if (Rf_xlength(accept_encoding) == 0 || n == 0) {
+    return NA_INTEGER;
+  }
+  std::string header = join_header(accept_encoding);
+  std::vector<sv> elements;
+  split_media_ranges(header, elements);
+  // -1 - not mentioned in the header
+  std::vector<double> q(n, -1);
+  double wildcard_q = -1;
+  std::string value;
+  for (sv el : elements) {
+    el = sv_trim(el);
+    sv coding = take_token(el);
+    if (coding.empty()) {
+      continue;
+    }
+    double el_q = 1;
+    bool valid = true;
+    // only 'q' parameter is defined for codings
+    while (valid) {
+      skip_ows(el);
+      if (el.empty()) {
+        break;
+      }
+      if (el.front() != ';') {
+        valid = false;
+        break;
+      }
+      el.remove_prefix(1);
+      skip_ows(el);
+      sv name = take_token(el);
+      if (name.empty() || el.empty() || el.front() != '=') {
+        valid = false;
+        break;
+      }
+      el.remove_prefix(1);
+      if (!take_param_value(el, value) || (lower(name) == "q" && !parse_qvalue(value, el_q))) {
+        valid = false;
+      }
+    }
+    if (!valid) {
+      continue;
+    }
+    std::string name = normalize_coding(coding);
+    if (name == "*") {
+      wildcard_q = el_q;
+      continue;
+    }
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SEXP av = STRING_ELT(available, i);
+      if (av != NA_STRING && normalize_coding(sv(CHAR(av), LENGTH(av))) == name) {
+        q[i] = el_q;
+      }
+    }
+  }
+  int best = NA_INTEGER;
+  double best_q = 0;
+  for (R_xlen_t i = 0; i < n; ++i) {
+    double value_q = q[i] < 0 ? wildcard_q : q[i];
+    if (value_q > best_q) {
+      best_q = value_q;
+      best = i + 1;
+    }
+  }
+  return best;
+}
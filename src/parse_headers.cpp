@@ -1,60 +1,126 @@
+#include <cstring>
 #include <vector>
 #include <string>
-#include <sstream>
-#include <unordered_map>
 #include <Rcpp.h>
+#include "nonstd/string_view.hpp"
 #include "utils.h"
 
-using Headers = std::unordered_map<std::string, std::vector<std::string>>;
+using sv = nonstd::string_view;
 
-bool validate_header_name(const std::string& x) {
-  const char* valid = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ01234567890!#$%&'*+-.^_`|~";
-  return x.find_first_not_of(valid) == std::string::npos;
+bool validate_header_name(sv x) {
+  for (sv::const_iterator it = x.begin(); it != x.end(); ++it) {
+    if (!is_tchar(*it)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// header field which keeps values as views into the original header block
+struct HeaderField {
+  std::string name;
+  bool split;
+  std::size_t n_values;
+};
+
+struct HeaderValue {
+  std::size_t field;
+  sv value;
+};
+
+// push values of the single header line, split by separator (if requested)
+// splitting follows std::getline semantic: no trailing empty value
+static void push_header_values(sv val, std::size_t field, bool split, char sep,
+                               std::vector<HeaderValue>& values) {
+  if (!split) {
+    values.push_back({field, sv_trim(val)});
+    return;
+  }
+  sv::size_type start = 0;
+  sv::size_type n = val.size();
+  while (start < n) {
+    sv::size_type pos = val.find(sep, start);
+    if (pos == sv::npos) {
+      pos = n;
+    }
+    values.push_back({field, sv_trim(val.substr(start, pos - start))});
+    start = pos + 1;
+  }
 }
 
 // [[Rcpp::export(rng=false)]]
 Rcpp::List cpp_parse_headers(const char* headers, Rcpp::Nullable<const Rcpp::CharacterVector> headers_to_split = R_NilValue) {
-  std::unordered_set<std::string> h_to_split;
+  std::vector<std::string> h_to_split;
   if (headers_to_split.isNotNull()) {
     const Rcpp::CharacterVector hts = Rcpp::CharacterVector(headers_to_split);
-    for(Rcpp::CharacterVector::const_iterator ptr = hts.begin(); ptr != hts.end(); ptr++) {
-      h_to_split.insert(Rcpp::as<std::string>(*ptr));
+    for (R_xlen_t i = 0; i < hts.size(); ++i) {
+      h_to_split.push_back(Rcpp::as<std::string>(hts[i]));
     }
   }
 
-  Headers res;
-  std::istringstream stream(headers);
-  std::string buffer;
-  while (std::getline(stream, buffer)) {
-    if (buffer.size() > 0 && *buffer.rbegin() == '\r') {
-      buffer.pop_back();
+  std::vector<HeaderField> fields;
+  std::vector<HeaderValue> values;
+  std::string key_buf;
+
+  const char* cur = headers;
+  const char* end = headers + std::strlen(headers);
+  while (cur < end) {
+    // memchr is vectorized by the C library, no need to walk byte by byte
+    const char* eol = static_cast<const char*>(std::memchr(cur, '\n', end - cur));
+    if (eol == nullptr) {
+      eol = end;
+    }
+    sv line(cur, eol - cur);
+    cur = eol + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
     }
-    if (buffer.empty()) {
+    if (line.empty()) {
       continue;
     }
-    std::string::size_type pos = buffer.find_first_of(':');
-    if (pos != std::string::npos) {
-      std::string key = buffer.substr(0, pos);
-      std::string val_str = buffer.substr(pos + 1);
-      str_trim(key);
-      str_lower(key);
-      if (!validate_header_name(key)) {
-        Rcpp::stop("header contains invalid character.");
-      }
-      char sep = key == "cookie" ? ';' : ',';
-      std::vector<std::string> val_vec;
-      if (h_to_split.find(key) != h_to_split.end()) {
-        str_split(val_str, val_vec, sep, true);
-      } else {
-        str_trim(val_str);
-        val_vec.push_back(val_str);
-      }
-
-      if (res.find(key) != res.end()) {
-        res[key].insert(res[key].end(), val_vec.begin(), val_vec.end());
+    const char* colon = static_cast<const char*>(std::memchr(line.data(), ':', line.size()));
+    if (colon == nullptr) {
+      continue;
+    }
+    sv key = sv_trim(line.substr(0, colon - line.data()));
+    sv val = line.substr(colon - line.data() + 1);
+    if (!validate_header_name(key)) {
+      Rcpp::stop("header contains invalid character.");
+    }
+    key_buf.assign(key.data(), key.size());
+    str_lower(key_buf);
+    // headers are merged by name in the order of their first appearance
+    std::size_t field = 0;
+    std::size_t n_fields = fields.size();
+    while (field < n_fields && fields[field].name != key_buf) {
+      ++field;
+    }
+    if (field == n_fields) {
+      bool split = false;
+      for (std::size_t j = 0; j < h_to_split.size() && !split; ++j) {
+        split = h_to_split[j] == key_buf;
       }
-      res.emplace(key, val_vec);
+      fields.push_back({key_buf, split, 0});
     }
+    char sep = fields[field].name == "cookie" ? ';' : ',';
+    std::size_t n_before = values.size();
+    push_header_values(val, field, fields[field].split, sep, values);
+    fields[field].n_values += values.size() - n_before;
+  }
+
+  // build named list directly from the views
+  std::size_t n_fields = fields.size();
+  Rcpp::List res(n_fields);
+  Rcpp::CharacterVector res_names(n_fields);
+  std::vector<R_xlen_t> filled(n_fields, 0);
+  for (std::size_t i = 0; i < n_fields; ++i) {
+    res[i] = Rcpp::CharacterVector(Rcpp::no_init(fields[i].n_values));
+    SET_STRING_ELT(res_names, i, Rf_mkCharLen(fields[i].name.data(), fields[i].name.size()));
+  }
+  for (std::vector<HeaderValue>::const_iterator it = values.begin(); it != values.end(); ++it) {
+    SEXP vec = VECTOR_ELT(res, it->field);
+    SET_STRING_ELT(vec, filled[it->field]++, Rf_mkCharLen(it->value.data(), it->value.size()));
   }
-  return Rcpp::wrap(res);
+  res.names() = res_names;
+  return res;
 }
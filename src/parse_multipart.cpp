@@ -1,7 +1,11 @@
 #include <Rcpp.h>
-#include <unordered_map>
-#include <iterator>
-#include <regex>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
 #include "nonstd/string_view.hpp"
 #include "utils.h"
 
@@ -19,93 +23,219 @@ struct MultipartFile {
   std::string content_type;
   std::size_t offset = 0;
   std::size_t length = 0;
+  // not empty if file was written to disk
+  std::string path;
 };
 
 using sv = nonstd::string_view;
 using sv_t = nonstd::string_view::size_type;
-using MultipartItems = std::unordered_map<std::string,std::string>;
-using MultipartFiles = std::unordered_map<std::string,MultipartFile>;
-
-namespace Rcpp {
-  template <>
-  SEXP wrap(const MultipartFile& x) {
-    Rcpp::List res = Rcpp::List::create(
-      Rcpp::Named("filename") = x.filename,
-      Rcpp::Named("content_type") = x.content_type,
-      Rcpp::Named("offset") = x.offset,
-      Rcpp::Named("length") = x.length
-    );
-    return res;
+// ordered multi-maps: repeated names (like 'files[]') are kept in the order of arrival
+using MultipartItems = std::vector<std::pair<std::string,sv>>;
+using MultipartFiles = std::vector<std::pair<std::string,MultipartFile>>;
+
+// Boyer-Moore-Horspool search for the boundary delimiter
+class BoundarySearcher {
+public:
+  explicit BoundarySearcher(const std::string& pattern) : pattern_(pattern) {
+    std::size_t n = pattern_.size();
+    for (std::size_t i = 0; i < 256; ++i) {
+      skip_[i] = n;
+    }
+    for (std::size_t i = 0; i + 1 < n; ++i) {
+      skip_[static_cast<unsigned char>(pattern_[i])] = n - 1 - i;
+    }
+  }
+  sv_t find(sv text, sv_t from) const {
+    std::size_t n = pattern_.size();
+    std::size_t text_n = text.size();
+    if (n == 0 || from > text_n || text_n - from < n) {
+      return sv::npos;
+    }
+    const char* s = text.data();
+    const char* p = pattern_.data();
+    unsigned char last = static_cast<unsigned char>(p[n - 1]);
+    std::size_t pos = from;
+    while (pos <= text_n - n) {
+      unsigned char c = static_cast<unsigned char>(s[pos + n - 1]);
+      if (c == last && std::memcmp(s + pos, p, n - 1) == 0) {
+        return pos;
+      }
+      pos += skip_[c];
+    }
+    return sv::npos;
+  }
+  std::size_t size() const {
+    return pattern_.size();
+  }
+private:
+  std::string pattern_;
+  std::size_t skip_[256];
+};
+
+static bool iequals(sv x, const char* y) {
+  std::size_t n = std::strlen(y);
+  if (x.size() != n) {
+    return false;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    if (std::tolower(static_cast<unsigned char>(x[i])) != y[i]) {
+      return false;
+    }
   }
+  return true;
 }
 
-void parse_multipart_block(sv block, std::size_t offset,
-                           MultipartFiles& files,
-                           MultipartItems& values) {
-  std::size_t block_n = block.size();
+// parameter value: token or quoted-string (with backslash escapes)
+static std::string parse_param_value(sv& s) {
+  std::string res;
+  if (!s.empty() && (s.front() == '"' || s.front() == '\'')) {
+    char quote = s.front();
+    s.remove_prefix(1);
+    while (!s.empty() && s.front() != quote) {
+      if (s.front() == '\\' && s.size() > 1) {
+        s.remove_prefix(1);
+      }
+      res.push_back(s.front());
+      s.remove_prefix(1);
+    }
+    // closing quote
+    if (!s.empty()) {
+      s.remove_prefix(1);
+    }
+    // skip anything up to the next parameter
+    sv_t pos = s.find(';');
+    s.remove_prefix(pos == sv::npos ? s.size() : pos);
+  } else {
+    sv_t pos = s.find(';');
+    sv val = s.substr(0, pos);
+    s.remove_prefix(val.size());
+    val = sv_trim(val);
+    res.assign(val.data(), val.size());
+  }
+  return res;
+}
+
+// RFC 5987 ext-value: charset "'" [ language ] "'" value-chars
+static std::string decode_ext_value(const std::string& x) {
+  std::string::size_type pos = x.find('\'');
+  if (pos != std::string::npos) {
+    pos = x.find('\'', pos + 1);
+  }
+  if (pos == std::string::npos) {
+    return x;
+  }
+  std::string res(x.size() - pos - 1, '\0');
+  res.resize(url_decode_to(x.data() + pos + 1, res.size(), &res[0], false));
+  return res;
+}
 
+struct ContentDisposition {
   std::string name;
-  MultipartFile form_file;
+  std::string filename;
+  bool has_filename = false;
+};
 
-  bool found_cdisp = false;
-  bool found_ctype = false;
-  bool found_file = false;
-
-  // end of line string
-  static std::string eol = "\r\n";
-  // size of EOL string
-  static std::size_t eol_n = eol.size();
-
-  // regex to match Content-Disposition header
-  static std::regex re_cdisp(
-    R"(Content-Disposition: form-data; name=((['"]).*?[.]$\2|[^;\n]*)(?:; filename[^;\n]*=((?:(?:utf)|(?:UTF))-\d['"]*)?((['"]).*?[.]$\5|[^;\n]*)?)*)",
-    std::regex_constants::icase
-  );
-  // regex to match Content-Type header
-  static std::regex re_ctype(
-    "Content-Type: (.*?)",
-    std::regex_constants::icase
-  );
+// Content-Disposition: form-data; name="field"; filename="file.txt"; filename*=utf-8''file.txt
+// see https://tools.ietf.org/html/rfc7578#section-4.2
+static ContentDisposition parse_content_disposition(sv s) {
+  ContentDisposition res;
+  bool has_ext_filename = false;
+  // skip disposition type
+  sv_t pos = s.find(';');
+  s.remove_prefix(pos == sv::npos ? s.size() : pos);
+  while (!s.empty()) {
+    // skip ';' and whitespaces
+    while (!s.empty() && (s.front() == ';' || is_space(s.front()))) {
+      s.remove_prefix(1);
+    }
+    sv_t eq = s.find('=');
+    if (eq == sv::npos) {
+      break;
+    }
+    sv key = sv_trim(s.substr(0, eq));
+    s.remove_prefix(eq + 1);
+    while (!s.empty() && is_space(s.front())) {
+      s.remove_prefix(1);
+    }
+    std::string val = parse_param_value(s);
+    if (iequals(key, "name")) {
+      res.name = val;
+    } else if (iequals(key, "filename*")) {
+      // extended notation takes precedence, see https://tools.ietf.org/html/rfc6266#section-4.3
+      res.filename = decode_ext_value(val);
+      res.has_filename = true;
+      has_ext_filename = true;
+    } else if (iequals(key, "filename") && !has_ext_filename) {
+      // browsers percent-encode '"', CR and LF in file names
+      // see https://html.spec.whatwg.org/#multipart-form-data
+      res.filename.assign(val.size(), '\0');
+      res.filename.resize(url_decode_to(val.data(), val.size(), &res.filename[0], false));
+      res.has_filename = true;
+    }
+  }
+  return res;
+}
 
+// parse single part: headers, empty line, content
+// 'offset' is position of the part in the body
+void parse_multipart_block(sv block, std::size_t offset,
+                           MultipartFiles& files,
+                           MultipartItems& values) {
+  ContentDisposition cdisp;
+  bool found_cdisp = false;
+  std::string content_type;
   sv_t cur_pos = 0;
-  sv_t next_pos = sv::npos;
-  while ((next_pos = block.find(eol, cur_pos)) != sv::npos) {
-    auto line_n = next_pos - cur_pos;
-    sv line = block.substr(cur_pos, line_n);
-    std::cmatch m;
-    if (!found_cdisp && std::regex_match(line.begin(), line.end(), m, re_cdisp)) {
-      name = strip_quotes(m[1]);
-      form_file.filename = strip_quotes(m[4]);
-      found_cdisp = true;
-      found_file = !form_file.filename.empty();
-    } else if (found_file && !found_ctype) {
-      if (std::regex_match(line.begin(), line.end(), m, re_ctype)) {
-        form_file.content_type = m[1];
-        form_file.offset += eol_n;
-      } else {
-        // default "text/plain" as per
-        // https://tools.ietf.org/html/rfc7578#section-4.4
-        form_file.content_type = "text/plain";
-      }
-      // offset by current line
-      form_file.offset += next_pos;
-      found_ctype = true;
-      // skip double empty line
-      form_file.offset += eol_n;
-      // add one for the R
-      form_file.offset += 1;
-      form_file.length = block_n - form_file.offset - 1;
-      // correct to block position
-      form_file.offset += offset;
-      files.insert({name, form_file});
+  sv_t content_pos = sv::npos;
+  while (cur_pos < block.size()) {
+    sv_t next_pos = block.find('\n', cur_pos);
+    if (next_pos == sv::npos) {
+      // no content after headers
       return;
-    } else if (found_cdisp && !found_file) {
-      if (!line.empty()) {
-        values.insert({name, std::string(line)});
-        return;
-      }
     }
-    cur_pos = next_pos + eol_n;
+    sv line = block.substr(cur_pos, next_pos - cur_pos);
+    cur_pos = next_pos + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    // empty line separates headers and content
+    if (line.empty()) {
+      content_pos = cur_pos;
+      break;
+    }
+    sv_t colon = line.find(':');
+    if (colon == sv::npos) {
+      continue;
+    }
+    sv name = sv_trim(line.substr(0, colon));
+    sv value = sv_trim(line.substr(colon + 1));
+    if (iequals(name, "content-disposition")) {
+      cdisp = parse_content_disposition(value);
+      found_cdisp = true;
+    } else if (iequals(name, "content-type")) {
+      content_type.assign(value.data(), value.size());
+    }
+  }
+  if (!found_cdisp || content_pos == sv::npos) {
+    return;
+  }
+  sv content = block.substr(content_pos);
+  // R strings can't contain embedded nul
+  if (cdisp.filename.find('\0') != std::string::npos ||
+      (!cdisp.has_filename && content.find('\0') != sv::npos)) {
+    Rcpp::stop("Multipart part '%s' contains embedded nul.", cdisp.name);
+  }
+  if (cdisp.has_filename) {
+    MultipartFile form_file;
+    form_file.filename = cdisp.filename;
+    // default "text/plain" as per
+    // https://tools.ietf.org/html/rfc7578#section-4.4
+    form_file.content_type = content_type.empty() ? "text/plain" : content_type;
+    // add one for the R
+    form_file.offset = offset + content_pos + 1;
+    form_file.length = content.size();
+    files.emplace_back(cdisp.name, form_file);
+  } else {
+    values.emplace_back(cdisp.name, content);
   }
 }
 
@@ -122,8 +252,53 @@ std::string cpp_parse_multipart_boundary(const std::string& content_type) {
     return res;
 }
 
+// file parts are written to disk by chunks of this size
+static const std::size_t spill_chunk_size = 1 << 20;
+
+// closes file on scope exit (including Rcpp::stop)
+class FileHandle {
+public:
+  explicit FileHandle(const std::string& path) : f_(std::fopen(path.c_str(), "wb")) {}
+  ~FileHandle() {
+    if (f_ != nullptr) {
+      std::fclose(f_);
+    }
+  }
+  std::FILE* get() const {
+    return f_;
+  }
+  bool close() {
+    bool res = std::fclose(f_) == 0;
+    f_ = nullptr;
+    return res;
+  }
+private:
+  std::FILE* f_;
+  FileHandle(const FileHandle&);
+  FileHandle& operator=(const FileHandle&);
+};
+
+static void spill_file(const char* data, std::size_t n, const std::string& path) {
+  FileHandle f(path);
+  if (f.get() == nullptr) {
+    Rcpp::stop("Can't open '%s' to write multipart file.", path);
+  }
+  for (std::size_t pos = 0; pos < n; pos += spill_chunk_size) {
+    std::size_t chunk_n = std::min(spill_chunk_size, n - pos);
+    if (std::fwrite(data + pos, 1, chunk_n, f.get()) != chunk_n) {
+      Rcpp::stop("Can't write multipart file to '%s'.", path);
+    }
+  }
+  if (!f.close()) {
+    Rcpp::stop("Can't write multipart file to '%s'.", path);
+  }
+}
+
+// file parts larger than 'spill_threshold' bytes are written to files
+// named '<spill_prefix>-<index>' (negative threshold disables it)
 // [[Rcpp::export(rng=false)]]
-Rcpp::List cpp_parse_multipart_body(Rcpp::RawVector body, const char* boundary) {
+Rcpp::List cpp_parse_multipart_body(Rcpp::RawVector body, const char* boundary,
+                                    double spill_threshold = -1, std::string spill_prefix = "") {
   // body size
   std::size_t body_n = body.size();
   // early stop
@@ -135,53 +310,139 @@ Rcpp::List cpp_parse_multipart_body(Rcpp::RawVector body, const char* boundary)
   MultipartItems form_values;
   // body as string representation
   sv body_sv(reinterpret_cast<const char*>(body.begin()), body_n);
-  // end of line string
-  static std::string eol = "\r\n";
-  // size of EOL string
-  static std::size_t eol_n = eol.size();
   // all others starts with '--'
   std::string boundary_ = "--";
   boundary_.append(boundary);
+  BoundarySearcher searcher(boundary_);
   // boundary size
-  std::size_t boundary_n = boundary_.size();
+  std::size_t boundary_n = searcher.size();
   // find boundary string
-  sv_t block_start_pos = body_sv.find(boundary_, 0);
+  sv_t block_start_pos = searcher.find(body_sv, 0);
   if (block_start_pos == sv::npos) {
     Rcpp::stop("Boundary string not found.");
   }
   // find second boundary string
-  sv_t block_end_pos = body_sv.find(boundary_, block_start_pos + 1);
+  sv_t block_end_pos = searcher.find(body_sv, block_start_pos + boundary_n);
   if (block_end_pos == sv::npos) {
     Rcpp::stop("Boundary string at the end block not found.");
   }
-  // define end block
+  std::size_t n_blocks = 0;
   while (block_start_pos != sv::npos) {
     // offset boundary string
     block_start_pos += boundary_n;
-    // offset eol after boundary
-    block_start_pos += eol_n;
+    // close delimiter
+    if (body_sv.substr(block_start_pos, 2) == "--") {
+      break;
+    }
+    // skip rest of the boundary line (transport padding and EOL)
+    block_start_pos = body_sv.find('\n', block_start_pos);
+    if (block_start_pos == sv::npos) {
+      break;
+    }
+    block_start_pos += 1;
     // find end of block
-    block_end_pos = body_sv.find(boundary_, block_start_pos);
-    // if block is valid
-    if (block_end_pos != sv::npos) {
-      auto block_size = block_end_pos - block_start_pos;
-      sv block = body_sv.substr(block_start_pos, block_size);
-      parse_multipart_block(block, block_start_pos, form_files, form_values);
-    }
-    // std::string_view block = body_sv.substr(start_pos + boundary_n + 2);
+    block_end_pos = searcher.find(body_sv, block_start_pos);
+    if (block_end_pos == sv::npos) {
+      break;
+    }
+    sv block = body_sv.substr(block_start_pos, block_end_pos - block_start_pos);
+    // EOL before the next boundary belongs to the delimiter
+    if (!block.empty() && block.back() == '\n') {
+      block.remove_suffix(1);
+      if (!block.empty() && block.back() == '\r') {
+        block.remove_suffix(1);
+      }
+    }
+    parse_multipart_block(block, block_start_pos, form_files, form_values);
     block_start_pos = block_end_pos;
-    Rcpp::checkUserInterrupt();
+    if (++n_blocks % 1024 == 0) {
+      Rcpp::checkUserInterrupt();
+    }
+  }
+
+  std::size_t n_files = form_files.size();
+  bool spilled = false;
+  if (spill_threshold >= 0) {
+    std::size_t i = 0;
+    try {
+      for (; i < n_files; ++i) {
+        MultipartFile& x = form_files[i].second;
+        if (x.length > spill_threshold) {
+          spilled = true;
+          x.path = spill_prefix + "-" + std::to_string(i + 1);
+          spill_file(body_sv.data() + x.offset - 1, x.length, x.path);
+        }
+      }
+    } catch (...) {
+      // don't leave partially written files behind
+      for (std::size_t j = 0; j <= i && j < n_files; ++j) {
+        if (!form_files[j].second.path.empty()) {
+          std::remove(form_files[j].second.path.c_str());
+        }
+      }
+      throw;
+    }
   }
+  Rcpp::List files(n_files);
+  Rcpp::CharacterVector files_names(n_files);
+  for (std::size_t i = 0; i < n_files; ++i) {
+    const MultipartFile& x = form_files[i].second;
+    if (x.path.empty() && spilled) {
+      // body is not kept when some of the parts are on disk,
+      // so the small parts are copied
+      Rcpp::RawVector content = Rcpp::no_init(x.length);
+      if (x.length > 0) {
+        std::memcpy(&content[0], body_sv.data() + x.offset - 1, x.length);
+      }
+      files[i] = Rcpp::List::create(
+        Rcpp::Named("filename") = x.filename,
+        Rcpp::Named("content_type") = x.content_type,
+        Rcpp::Named("offset") = static_cast<double>(x.offset),
+        Rcpp::Named("length") = static_cast<double>(x.length),
+        Rcpp::Named("content") = content
+      );
+    } else if (x.path.empty()) {
+      files[i] = Rcpp::List::create(
+        Rcpp::Named("filename") = x.filename,
+        Rcpp::Named("content_type") = x.content_type,
+        Rcpp::Named("offset") = static_cast<double>(x.offset),
+        Rcpp::Named("length") = static_cast<double>(x.length)
+      );
+    } else {
+      files[i] = Rcpp::List::create(
+        Rcpp::Named("filename") = x.filename,
+        Rcpp::Named("content_type") = x.content_type,
+        Rcpp::Named("offset") = static_cast<double>(x.offset),
+        Rcpp::Named("length") = static_cast<double>(x.length),
+        Rcpp::Named("path") = x.path
+      );
+    }
+    files_names[i] = form_files[i].first;
+  }
+  files.names() = files_names;
+
+  std::size_t n_values = form_values.size();
+  Rcpp::List values(n_values);
+  Rcpp::CharacterVector values_names(n_values);
+  for (std::size_t i = 0; i < n_values; ++i) {
+    Rcpp::CharacterVector value(1);
+    // values with embedded nul are rejected by parse_multipart_block()
+    sv x = form_values[i].second;
+    SET_STRING_ELT(value, 0, Rf_mkCharLen(x.data(), x.size()));
+    values[i] = value;
+    values_names[i] = form_values[i].first;
+  }
+  values.names() = values_names;
+
   Rcpp::List res = Rcpp::List::create(
-    Rcpp::Named("files") = Rcpp::wrap(form_files),
-    Rcpp::Named("values") = Rcpp::as<Rcpp::List>(Rcpp::wrap(form_values))
+    Rcpp::Named("files") = files,
+    Rcpp::Named("values") = values
   );
   return res;
 }
 
 // see https://github.com/rexyai/RestRserve/issues/151
 // https://stackoverflow.com/questions/56614592/faster-way-to-slice-a-raw-vector
-
 // [[Rcpp::export(rng=false)]]
 Rcpp::RawVector raw_slice(const Rcpp::RawVector &x, const R_xlen_t offset, const R_xlen_t size) {
   Rcpp::RawVector result = Rcpp::no_init(size);
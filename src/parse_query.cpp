@@ -0,0 +1,218 @@
+#include <Rcpp.h>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+enum class QueryType { character, integer, numeric, logical };
+
+// key-value pairs grouped by key in order of the first appearance
+class QueryParams {
+public:
+  void add(sv key, sv value) {
+    // omit empty keys and empty values
+    if (key.empty() || value.empty()) {
+      return;
+    }
+    std::string k(key.data(), key.size());
+    auto it = index_.find(k);
+    if (it == index_.end()) {
+      index_.emplace(k, keys_.size());
+      keys_.push_back(key);
+      values_.push_back(std::vector<sv>(1, value));
+    } else {
+      values_[it->second].push_back(value);
+    }
+  }
+  std::size_t size() const {
+    return keys_.size();
+  }
+  sv key(std::size_t i) const {
+    return keys_[i];
+  }
+  const std::vector<sv>& values(std::size_t i) const {
+    return values_[i];
+  }
+private:
+  std::vector<sv> keys_;
+  std::vector<std::vector<sv>> values_;
+  std::unordered_map<std::string, std::size_t> index_;
+};
+
+static QueryType parse_query_type(const char* x) {
+  if (std::strcmp(x, "integer") == 0) return QueryType::integer;
+  if (std::strcmp(x, "numeric") == 0) return QueryType::numeric;
+  if (std::strcmp(x, "logical") == 0) return QueryType::logical;
+  if (std::strcmp(x, "character") == 0) return QueryType::character;
+  Rcpp::stop("unknown query parameter type '%s'.", x);
+}
+
+static QueryType find_query_type(sv key, SEXP types, SEXP types_names) {
+  R_xlen_t n = Rf_xlength(types);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP nm = STRING_ELT(types_names, i);
+    if (key == sv(CHAR(nm), LENGTH(nm))) {
+      return parse_query_type(CHAR(STRING_ELT(types, i)));
+    }
+  }
+  return QueryType::character;
+}
+
+// strtol/strtod need null terminated input
+static const char* c_str(sv x, std::string& buf) {
+  buf.assign(x.data(), x.size());
+  return buf.c_str();
+}
+
+static int to_int(sv x, std::string& buf) {
+  const char* s = c_str(x, buf);
+  char* end;
+  errno = 0;
+  long res = std::strtol(s, &end, 10);
+  if (end == s || *end != '\0' || errno == ERANGE || res > INT_MAX || res <= INT_MIN) {
+    return NA_INTEGER;
+  }
+  return static_cast<int>(res);
+}
+
+static double to_double(sv x, std::string& buf) {
+  const char* s = c_str(x, buf);
+  char* end;
+  double res = std::strtod(s, &end);
+  if (end == s || *end != '\0') {
+    return NA_REAL;
+  }
+  return res;
+}
+
+static int to_logical(sv x) {
+  if (x == "true" || x == "TRUE" || x == "True" || x == "T" || x == "1") return TRUE;
+  if (x == "false" || x == "FALSE" || x == "False" || x == "F" || x == "0") return FALSE;
+  return NA_LOGICAL;
+}
+
+static SEXP make_values(const std::vector<sv>& values, QueryType type) {
+  R_xlen_t n = values.size();
+  std::string buf;
+  SEXP res;
+  switch (type) {
+  case QueryType::integer:
+    res = PROTECT(Rf_allocVector(INTSXP, n));
+    for (R_xlen_t i = 0; i < n; ++i) INTEGER(res)[i] = to_int(values[i], buf);
+    break;
+  case QueryType::numeric:
+    res = PROTECT(Rf_allocVector(REALSXP, n));
+    for (R_xlen_t i = 0; i < n; ++i) REAL(res)[i] = to_double(values[i], buf);
+    break;
+  case QueryType::logical:
+    res = PROTECT(Rf_allocVector(LGLSXP, n));
+    for (R_xlen_t i = 0; i < n; ++i) LOGICAL(res)[i] = to_logical(values[i]);
+    break;
+  default:
+    res = PROTECT(Rf_allocVector(STRSXP, n));
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SET_STRING_ELT(res, i, Rf_mkCharLen(values[i].data(), values[i].size()));
+    }
+  }
+  UNPROTECT(1);
+  return res;
+}
+
+// splits 'key=value&key=value' string, decoded pieces are written to 'buf'
+static void parse_query_string(sv query, std::string& buf, QueryParams& params) {
+  // decoded string can't be longer than the original one,
+  // so views to 'buf' stay valid
+  buf.resize(query.size());
+  char* out = &buf[0];
+  std::size_t pos = 0;
+  while (pos <= query.size()) {
+    std::size_t end = query.find('&', pos);
+    if (end == sv::npos) {
+      end = query.size();
+    }
+    sv pair = query.substr(pos, end - pos);
+    std::size_t eq = pair.find('=');
+    sv key = pair.substr(0, eq);
+    sv value = eq == sv::npos ? sv() : pair.substr(eq + 1);
+    std::size_t key_n = url_decode_to(key.data(), key.size(), out);
+    sv key_decoded(out, key_n);
+    out += key_n;
+    std::size_t value_n = url_decode_to(value.data(), value.size(), out);
+    sv value_decoded(out, value_n);
+    out += value_n;
+    params.add(key_decoded, value_decoded);
+    pos = end + 1;
+  }
+}
+
+static Rcpp::List make_params(const QueryParams& params, SEXP types) {
+  if (!Rf_isNull(types) && TYPEOF(types) != STRSXP) {
+    Rcpp::stop("'types' must be character vector.");
+  }
+  SEXP types_names = Rf_getAttrib(types, R_NamesSymbol);
+  if (Rf_xlength(types) > 0 && Rf_isNull(types_names)) {
+    Rcpp::stop("'types' must be named.");
+  }
+  std::size_t n_params = params.size();
+  Rcpp::List res(n_params);
+  Rcpp::CharacterVector res_names(n_params);
+  for (std::size_t i = 0; i < n_params; ++i) {
+    sv key = params.key(i);
+    QueryType type = Rf_xlength(types) > 0 ? find_query_type(key, types, types_names) : QueryType::character;
+    res[i] = make_values(params.values(i), type);
+    SET_STRING_ELT(res_names, i, Rf_mkCharLen(key.data(), key.size()));
+  }
+  res.names() = res_names;
+  return res;
+}
+
+// 'x' is either raw query string ('a=1&b=2'), raw vector with url encoded
+// form body or named character vector with already decoded values (as Rserve provides)
+// 'types' is a named character vector with types of the parameters
+// [[Rcpp::export(rng=false)]]
+Rcpp::List cpp_parse_query(SEXP x, SEXP types = R_NilValue) {
+  if (TYPEOF(x) == RAWSXP) {
+    QueryParams params;
+    std::string buf;
+    parse_query_string(sv(reinterpret_cast<const char*>(RAW(x)), Rf_xlength(x)), buf, params);
+    return make_params(params, types);
+  }
+  if (!Rf_isNull(x) && TYPEOF(x) != STRSXP) {
+    Rcpp::stop("'x' must be character or raw vector.");
+  }
+  QueryParams params;
+  std::string buf;
+  SEXP x_names = Rf_getAttrib(x, R_NamesSymbol);
+  R_xlen_t n = Rf_xlength(x);
+  if (Rf_isNull(x_names)) {
+    if (n > 1) {
+      Rcpp::stop("'x' must be named or a string.");
+    }
+    if (n == 1 && STRING_ELT(x, 0) != NA_STRING) {
+      SEXP s = STRING_ELT(x, 0);
+      sv query(CHAR(s), LENGTH(s));
+      // leading '?' is allowed
+      if (!query.empty() && query.front() == '?') {
+        query.remove_prefix(1);
+      }
+      parse_query_string(query, buf, params);
+    }
+  } else {
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SEXP key = STRING_ELT(x_names, i);
+      SEXP value = STRING_ELT(x, i);
+      if (value == NA_STRING) {
+        continue;
+      }
+      params.add(sv(CHAR(key), LENGTH(key)), sv(CHAR(value), LENGTH(value)));
+    }
+  }
+
+  return make_params(params, types);
+}
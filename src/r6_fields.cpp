@@ -0,0 +1,52 @@
+#include <Rcpp.h>
+
+// Request and Response objects are reused between requests, so their fields
+// are reset after each request. Assigning fields one by one from R goes
+// through the R6 environment bindings in the interpreter, here it is a
+// single call which binds preallocated default values.
+
+// assigns 'values' (named list) to the fields of R6 object 'env'
+// values are shared between objects and resets, so they are marked as not
+// mutable - modification of a field in place makes a copy
+// [[Rcpp::export(rng=false)]]
+void cpp_reset_fields(SEXP env, SEXP values) {
+  if (TYPEOF(env) != ENVSXP) {
+    Rcpp::stop("'env' must be an environment.");
+  }
+  SEXP names = Rf_getAttrib(values, R_NamesSymbol);
+  if (TYPEOF(values) != VECSXP || TYPEOF(names) != STRSXP) {
+    Rcpp::stop("'values' must be a named list.");
+  }
+  R_xlen_t n = Rf_xlength(values);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP value = VECTOR_ELT(values, i);
+    MARK_NOT_MUTABLE(value);
+    Rf_defineVar(Rf_installChar(STRING_ELT(names, i)), value, env);
+  }
+}
+
+// copies 'fields' of R6 object 'from' to R6 object 'to'
+// [[Rcpp::export(rng=false)]]
+void cpp_copy_fields(SEXP from, SEXP to, SEXP fields) {
+  if (TYPEOF(from) != ENVSXP || TYPEOF(to) != ENVSXP) {
+    Rcpp::stop("'from' and 'to' must be environments.");
+  }
+  if (TYPEOF(fields) != STRSXP) {
+    Rcpp::stop("'fields' must be a character vector.");
+  }
+  R_xlen_t n = Rf_xlength(fields);
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP sym = Rf_installChar(STRING_ELT(fields, i));
+    SEXP value = Rf_findVarInFrame(from, sym);
+    if (value == R_UnboundValue) {
+      Rcpp::stop("Field '%s' doesn't exist.", CHAR(STRING_ELT(fields, i)));
+    }
+    if (TYPEOF(value) == PROMSXP) {
+      value = Rf_eval(value, from);
+    }
+    PROTECT(value);
+    MARK_NOT_MUTABLE(value);
+    Rf_defineVar(sym, value, to);
+    UNPROTECT(1);
+  }
+}
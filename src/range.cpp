@@ -0,0 +1,438 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "utils.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using sv = nonstd::string_view;
+
+// Range requests (RFC 7233): 'Range: bytes=0-99,200-,-500'
+// Ranges are resolved against the final response body (raw, string or file),
+// for files only the requested windows are read.
+
+// inclusive byte range
+struct ByteRange {
+  uint64_t first;
+  uint64_t last;
+};
+
+enum class RangeStatus {IGNORE, UNSATISFIABLE, OK};
+
+// requests with more ranges are answered with the full body
+static const std::size_t max_ranges = 100;
+
+// concatenates header values (header might be split by comma)
+static std::string header_value(SEXP x) {
+  std::string res;
+  if (TYPEOF(x) != STRSXP) {
+    return res;
+  }
+  for (R_xlen_t i = 0; i < Rf_xlength(x); ++i) {
+    SEXP el = STRING_ELT(x, i);
+    if (el == NA_STRING) {
+      continue;
+    }
+    if (!res.empty()) {
+      res.append(", ");
+    }
+    res.append(CHAR(el), LENGTH(el));
+  }
+  return res;
+}
+
+// parses digits, returns false if there are none
+// too large values are saturated (they are larger than any body anyway)
+static bool parse_digits(sv x, uint64_t& res) {
+  if (x.empty()) {
+    return false;
+  }
+  res = 0;
+  for (char c : x) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    if (res < UINT64_MAX / 10 - 10) {
+      res = res * 10 + static_cast<uint64_t>(c - '0');
+    }
+  }
+  return true;
+}
+
+// resolves 'Range' header value against body of 'size' bytes
+// satisfiable ranges are sorted and overlapping or adjacent ones are merged
+static RangeStatus parse_ranges(sv x, uint64_t size, std::vector<ByteRange>& res) {
+  x = sv_trim(x);
+  // only bytes unit is supported, range of other units is ignored
+  if (x.size() < 6 || (x[0] | 0x20) != 'b' || (x[1] | 0x20) != 'y' || (x[2] | 0x20) != 't' ||
+      (x[3] | 0x20) != 'e' || (x[4] | 0x20) != 's') {
+    return RangeStatus::IGNORE;
+  }
+  x = sv_trim(x.substr(5));
+  if (x.empty() || x[0] != '=') {
+    return RangeStatus::IGNORE;
+  }
+  x.remove_prefix(1);
+  std::size_t n_specs = 0;
+  while (!x.empty()) {
+    std::size_t pos = x.find(',');
+    sv spec = sv_trim(x.substr(0, pos));
+    x = pos == sv::npos ? sv() : x.substr(pos + 1);
+    // empty list elements are allowed
+    if (spec.empty()) {
+      continue;
+    }
+    if (++n_specs > max_ranges) {
+      return RangeStatus::IGNORE;
+    }
+    std::size_t dash = spec.find('-');
+    if (dash == sv::npos) {
+      return RangeStatus::IGNORE;
+    }
+    uint64_t first, last;
+    if (dash == 0) {
+      // suffix range: last N bytes
+      uint64_t n;
+      if (!parse_digits(spec.substr(1), n)) {
+        return RangeStatus::IGNORE;
+      }
+      if (n == 0 || size == 0) {
+        continue;
+      }
+      first = n < size ? size - n : 0;
+      last = size - 1;
+    } else {
+      if (!parse_digits(sv_trim(spec.substr(0, dash)), first)) {
+        return RangeStatus::IGNORE;
+      }
+      sv tail = sv_trim(spec.substr(dash + 1));
+      if (tail.empty()) {
+        last = UINT64_MAX;
+      } else if (!parse_digits(tail, last) || last < first) {
+        // syntactically invalid range makes the whole header invalid
+        return RangeStatus::IGNORE;
+      }
+      if (first >= size) {
+        continue;
+      }
+      last = std::min(last, size - 1);
+    }
+    res.push_back({first, last});
+  }
+  if (n_specs == 0) {
+    return RangeStatus::IGNORE;
+  }
+  if (res.empty()) {
+    return RangeStatus::UNSATISFIABLE;
+  }
+  std::sort(res.begin(), res.end(), [](const ByteRange& a, const ByteRange& b) {
+    return a.first < b.first;
+  });
+  std::size_t k = 0;
+  for (std::size_t i = 1; i < res.size(); ++i) {
+    if (res[i].first <= res[k].last + 1) {
+      res[k].last = std::max(res[k].last, res[i].last);
+    } else {
+      res[++k] = res[i];
+    }
+  }
+  res.resize(k + 1);
+  return RangeStatus::OK;
+}
+
+// 'If-Range' holds either a strong entity tag or a date, the range is
+// applied only if it matches the current representation
+static bool if_range_matches(SEXP if_range, SEXP etag, SEXP last_modified) {
+  std::string value = header_value(if_range);
+  sv x = sv_trim(value);
+  if (x.empty() || (x.size() > 2 && x[0] == 'W' && x[1] == '/')) {
+    return false;
+  }
+  std::string tag = header_value(etag);
+  if (!tag.empty() && x == sv(tag) && tag[0] != 'W') {
+    return true;
+  }
+  if (x[0] == '"') {
+    return false;
+  }
+  std::string lm = header_value(last_modified);
+  double since = parse_http_date(x);
+  double modified = lm.empty() ? NA_REAL : parse_http_date(lm);
+  return !ISNAN(since) && !ISNAN(modified) && since == modified;
+}
+
+// reads windows of the file with pread() (fseek() on Windows)
+class FileWindow {
+public:
+  explicit FileWindow(const char* path) {
+#ifdef _WIN32
+    f_ = std::fopen(path, "rb");
+#else
+    fd_ = ::open(path, O_RDONLY);
+#endif
+  }
+  ~FileWindow() {
+#ifdef _WIN32
+    if (f_ != NULL) {
+      std::fclose(f_);
+    }
+#else
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+#endif
+  }
+  bool is_open() const {
+#ifdef _WIN32
+    return f_ != NULL;
+#else
+    return fd_ >= 0;
+#endif
+  }
+  bool read(uint64_t offset, uint64_t n, unsigned char* out) {
+#ifdef _WIN32
+    if (_fseeki64(f_, static_cast<__int64>(offset), SEEK_SET) != 0) {
+      return false;
+    }
+    return std::fread(out, 1, n, f_) == n;
+#else
+    while (n > 0) {
+      ssize_t k = ::pread(fd_, out, n, static_cast<off_t>(offset));
+      if (k <= 0) {
+        return false;
+      }
+      out += k;
+      offset += static_cast<uint64_t>(k);
+      n -= static_cast<uint64_t>(k);
+    }
+    return true;
+#endif
+  }
+private:
+#ifdef _WIN32
+  std::FILE* f_ = NULL;
+#else
+  int fd_ = -1;
+#endif
+};
+
+// body of the response: bytes in memory or file (c(file = ) / c(tmpfile = ))
+struct RangeBody {
+  const unsigned char* data = nullptr;
+  const char* path = nullptr;
+  bool tmpfile = false;
+  uint64_t size = 0;
+};
+
+static bool get_body(SEXP body, RangeBody& res) {
+  if (TYPEOF(body) == RAWSXP) {
+    res.data = RAW(body);
+    res.size = static_cast<uint64_t>(XLENGTH(body));
+    return true;
+  }
+  if (TYPEOF(body) != STRSXP || Rf_xlength(body) != 1 || STRING_ELT(body, 0) == NA_STRING) {
+    return false;
+  }
+  SEXP names = Rf_getAttrib(body, R_NamesSymbol);
+  const char* name = TYPEOF(names) == STRSXP ? CHAR(STRING_ELT(names, 0)) : "";
+  if (std::strcmp(name, "file") == 0 || std::strcmp(name, "tmpfile") == 0) {
+    FileId id;
+    res.path = CHAR(STRING_ELT(body, 0));
+    res.tmpfile = name[0] == 't';
+    if (!stat_file(res.path, id)) {
+      return false;
+    }
+    res.size = static_cast<uint64_t>(id.size);
+    return true;
+  }
+  res.data = reinterpret_cast<const unsigned char*>(CHAR(STRING_ELT(body, 0)));
+  res.size = static_cast<uint64_t>(LENGTH(STRING_ELT(body, 0)));
+  return true;
+}
+
+static void append_range(std::string& out, const ByteRange& r, uint64_t size) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "bytes %llu-%llu/%llu",
+                static_cast<unsigned long long>(r.first),
+                static_cast<unsigned long long>(r.last),
+                static_cast<unsigned long long>(size));
+  out.append(buf);
+}
+
+static std::string multipart_boundary() {
+  static uint64_t counter = 0;
+  uint64_t x = static_cast<uint64_t>(
+    std::chrono::high_resolution_clock::now().time_since_epoch().count()) + (++counter);
+  // splitmix64 finalizer
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  char buf[40];
+  std::snprintf(buf, sizeof(buf), "RestRserve%016llx", static_cast<unsigned long long>(x));
+  return buf;
+}
+
+// copies 'n' bytes of the file from 'offset' to 'out' by chunks
+static bool copy_window(FileWindow& file, uint64_t offset, uint64_t n, std::FILE* out) {
+  static const uint64_t chunk = 1 << 20;
+  std::vector<unsigned char> buf(static_cast<std::size_t>(std::min(n, chunk)));
+  while (n > 0) {
+    std::size_t k = static_cast<std::size_t>(std::min(n, chunk));
+    if (!file.read(offset, k, buf.data()) || std::fwrite(buf.data(), 1, k, out) != k) {
+      return false;
+    }
+    offset += k;
+    n -= k;
+  }
+  return true;
+}
+
+static SEXP mk_string(const std::string& x) {
+  return Rf_mkCharLenCE(x.data(), static_cast<int>(x.size()), CE_UTF8);
+}
+
+// applies 'range' request header to the response body
+// returns NULL if the full response should be sent (no valid range, range
+// covers the whole body or 'if_range' doesn't match), otherwise
+// list(status_code, body, content_type) with 'content_range' attribute.
+// Status code is 206 (single range or multipart/byteranges body without
+// 'content_range' for several ranges) or 416 if none of the ranges is
+// satisfiable. Windows of files larger than 'max_window' bytes are written
+// to 'tmp' file (body is c(tmpfile = tmp)) instead of memory, without 'tmp'
+// the full response is sent
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_range_response(SEXP body, const std::string& content_type, SEXP range,
+                        SEXP if_range = R_NilValue, SEXP etag = R_NilValue,
+                        SEXP last_modified = R_NilValue, double max_window = 16777216,
+                        SEXP tmp = R_NilValue) {
+  RangeBody src;
+  if (!get_body(body, src)) {
+    return R_NilValue;
+  }
+  if (if_range != R_NilValue && !if_range_matches(if_range, etag, last_modified)) {
+    return R_NilValue;
+  }
+  std::vector<ByteRange> ranges;
+  std::string value = header_value(range);
+  RangeStatus status = parse_ranges(value, src.size, ranges);
+  if (status == RangeStatus::IGNORE) {
+    return R_NilValue;
+  }
+  if (status == RangeStatus::OK && ranges.size() == 1 && ranges[0].first == 0 &&
+      ranges[0].last + 1 == src.size) {
+    // e.g. 'bytes=0-', plain 200 response is sent without copying the body
+    return R_NilValue;
+  }
+
+  std::string content_range;
+  std::string type = content_type;
+  SEXP res_body = R_NilValue;
+  int status_code = 206;
+  if (status == RangeStatus::UNSATISFIABLE) {
+    status_code = 416;
+    content_range = "bytes */" + std::to_string(static_cast<unsigned long long>(src.size));
+  } else {
+    // parts headers and total size of the body
+    std::vector<std::string> heads;
+    std::string boundary;
+    uint64_t total = 0;
+    if (ranges.size() == 1) {
+      append_range(content_range, ranges[0], src.size);
+      total = ranges[0].last - ranges[0].first + 1;
+    } else {
+      boundary = multipart_boundary();
+      type = "multipart/byteranges; boundary=" + boundary;
+      for (const auto& r : ranges) {
+        std::string head = "\r\n--" + boundary + "\r\nContent-Type: " + content_type +
+          "\r\nContent-Range: ";
+        append_range(head, r, src.size);
+        head.append("\r\n\r\n");
+        total += head.size() + (r.last - r.first + 1);
+        heads.push_back(std::move(head));
+      }
+      total += boundary.size() + 8;
+    }
+    FileWindow file(src.path != nullptr ? src.path : "");
+    if (src.path != nullptr && !file.is_open()) {
+      return R_NilValue;
+    }
+    std::string tail;
+    if (!heads.empty()) {
+      tail = "\r\n--" + boundary + "--\r\n";
+    }
+    bool ok = true;
+    if (src.path != nullptr && static_cast<double>(total) > max_window) {
+      // large windows are not read into memory
+      if (TYPEOF(tmp) != STRSXP || Rf_xlength(tmp) != 1 || STRING_ELT(tmp, 0) == NA_STRING) {
+        return R_NilValue;
+      }
+      const char* tmp_path = R_ExpandFileName(Rf_translateChar(STRING_ELT(tmp, 0)));
+      std::FILE* out = std::fopen(tmp_path, "wb");
+      if (out == NULL) {
+        return R_NilValue;
+      }
+      for (std::size_t i = 0; i < ranges.size() && ok; ++i) {
+        if (!heads.empty()) {
+          ok = std::fwrite(heads[i].data(), 1, heads[i].size(), out) == heads[i].size();
+        }
+        ok = ok && copy_window(file, ranges[i].first, ranges[i].last - ranges[i].first + 1, out);
+      }
+      ok = ok && std::fwrite(tail.data(), 1, tail.size(), out) == tail.size();
+      ok = std::fclose(out) == 0 && ok;
+      if (!ok) {
+        std::remove(tmp_path);
+        return R_NilValue;
+      }
+      res_body = PROTECT(Rf_ScalarString(PROTECT(Rf_mkChar(tmp_path))));
+      Rf_setAttrib(res_body, R_NamesSymbol, PROTECT(Rf_mkString("tmpfile")));
+      UNPROTECT(3);
+    } else {
+      res_body = PROTECT(Rf_allocVector(RAWSXP, static_cast<R_xlen_t>(total)));
+      unsigned char* out = RAW(res_body);
+      for (std::size_t i = 0; i < ranges.size() && ok; ++i) {
+        if (!heads.empty()) {
+          std::memcpy(out, heads[i].data(), heads[i].size());
+          out += heads[i].size();
+        }
+        uint64_t n = ranges[i].last - ranges[i].first + 1;
+        if (src.path != nullptr) {
+          ok = file.read(ranges[i].first, n, out);
+        } else {
+          std::memcpy(out, src.data + ranges[i].first, n);
+        }
+        out += n;
+      }
+      std::memcpy(out, tail.data(), tail.size());
+      UNPROTECT(1);
+    }
+    if (!ok) {
+      // file was truncated in the meantime
+      return R_NilValue;
+    }
+  }
+  PROTECT(res_body);
+  SEXP range_sym = Rf_install("content_range");
+  static const char* names[] = {"status_code", "body", "content_type", ""};
+  SEXP res = PROTECT(Rf_mkNamed(VECSXP, names));
+  SET_VECTOR_ELT(res, 0, Rf_ScalarInteger(status_code));
+  SET_VECTOR_ELT(res, 1, res_body);
+  SET_VECTOR_ELT(res, 2, Rf_ScalarString(PROTECT(mk_string(type))));
+  // multipart/byteranges parts have their own Content-Range
+  if (!content_range.empty()) {
+    Rf_setAttrib(res, range_sym, Rf_ScalarString(PROTECT(mk_string(content_range))));
+    UNPROTECT(1);
+  }
+  UNPROTECT(3);
+  if (src.tmpfile) {
+    // temporary file is not sent anymore (the range or 416 error is sent
+    // instead), so backend will not remove it
+    std::remove(src.path);
+  }
+  return res;
+}
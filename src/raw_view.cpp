@@ -0,0 +1,132 @@
+#include <Rcpp.h>
+#include <cstring>
+extern "C" {
+#include <R_ext/Altrep.h>
+}
+
+// ALTREP raw vector which is a window into the parent raw vector (request body)
+// data1 - parent raw vector (or own copy after materialization)
+// data2 - double vector c(offset, length, materialized), offset is 0-based
+static R_altrep_class_t raw_view_class;
+
+static double* raw_view_info(SEXP x) {
+  return REAL(R_altrep_data2(x));
+}
+
+static bool raw_view_materialized(SEXP x) {
+  return raw_view_info(x)[2] != 0;
+}
+
+static R_xlen_t raw_view_offset(SEXP x) {
+  return static_cast<R_xlen_t>(raw_view_info(x)[0]);
+}
+
+static R_xlen_t raw_view_length(SEXP x) {
+  return static_cast<R_xlen_t>(raw_view_info(x)[1]);
+}
+
+// parent is never a not materialized view (see raw_view()) so RAW() doesn't copy
+static Rbyte* raw_view_ptr(SEXP x) {
+  return RAW(R_altrep_data1(x)) + raw_view_offset(x);
+}
+
+// copies window into the own vector, so it can be safely modified
+static void raw_view_materialize(SEXP x) {
+  if (raw_view_materialized(x)) {
+    return;
+  }
+  R_xlen_t n = raw_view_length(x);
+  SEXP res = PROTECT(Rf_allocVector(RAWSXP, n));
+  if (n > 0) {
+    std::memcpy(RAW(res), raw_view_ptr(x), n);
+  }
+  R_set_altrep_data1(x, res);
+  double* info = raw_view_info(x);
+  info[0] = 0;
+  info[2] = 1;
+  UNPROTECT(1);
+}
+
+static SEXP raw_view_make(SEXP parent, R_xlen_t offset, R_xlen_t size) {
+  SEXP info = PROTECT(Rf_allocVector(REALSXP, 3));
+  REAL(info)[0] = static_cast<double>(offset);
+  REAL(info)[1] = static_cast<double>(size);
+  REAL(info)[2] = 0;
+  SEXP res = R_new_altrep(raw_view_class, parent, info);
+  UNPROTECT(1);
+  return res;
+}
+
+static R_xlen_t raw_view_Length(SEXP x) {
+  return raw_view_length(x);
+}
+
+static Rboolean raw_view_Inspect(SEXP x, int pre, int deep, int pvec,
+                                 void (*inspect_subtree)(SEXP, int, int, int)) {
+  Rprintf("raw_view (offset=%.0f, length=%.0f, materialized=%d)\n",
+          raw_view_info(x)[0], raw_view_info(x)[1], raw_view_materialized(x));
+  return TRUE;
+}
+
+// copy of not modified view is another view on the same parent
+static SEXP raw_view_Duplicate(SEXP x, Rboolean deep) {
+  if (raw_view_materialized(x)) {
+    return NULL;
+  }
+  return raw_view_make(R_altrep_data1(x), raw_view_offset(x), raw_view_length(x));
+}
+
+static void* raw_view_Dataptr(SEXP x, Rboolean writeable) {
+  if (writeable) {
+    raw_view_materialize(x);
+  }
+  return raw_view_ptr(x);
+}
+
+static const void* raw_view_Dataptr_or_null(SEXP x) {
+  return raw_view_ptr(x);
+}
+
+static Rbyte raw_view_Elt(SEXP x, R_xlen_t i) {
+  return raw_view_ptr(x)[i];
+}
+
+static R_xlen_t raw_view_Get_region(SEXP x, R_xlen_t i, R_xlen_t n, Rbyte* buf) {
+  R_xlen_t size = raw_view_length(x);
+  R_xlen_t ncopy = size - i > n ? n : size - i;
+  if (ncopy > 0) {
+    std::memcpy(buf, raw_view_ptr(x) + i, ncopy);
+  }
+  return ncopy;
+}
+
+// [[Rcpp::init]]
+void init_raw_view(DllInfo* dll) {
+  raw_view_class = R_make_altraw_class("raw_view", "RestRserve", dll);
+  R_set_altrep_Length_method(raw_view_class, raw_view_Length);
+  R_set_altrep_Inspect_method(raw_view_class, raw_view_Inspect);
+  R_set_altrep_Duplicate_method(raw_view_class, raw_view_Duplicate);
+  R_set_altvec_Dataptr_method(raw_view_class, raw_view_Dataptr);
+  R_set_altvec_Dataptr_or_null_method(raw_view_class, raw_view_Dataptr_or_null);
+  R_set_altraw_Elt_method(raw_view_class, raw_view_Elt);
+  R_set_altraw_Get_region_method(raw_view_class, raw_view_Get_region);
+}
+
+// zero-copy alternative to raw_slice(): returned vector refers to 'x' memory
+// and copies data only when it is modified
+// [[Rcpp::export(rng=false)]]
+SEXP raw_view(SEXP x, R_xlen_t offset, R_xlen_t size) {
+  if (TYPEOF(x) != RAWSXP) {
+    Rcpp::stop("'x' must be raw vector.");
+  }
+  if (offset < 1 || size < 0 || offset - 1 + size > Rf_xlength(x)) {
+    Rcpp::stop("'offset' and 'size' are out of 'x' bounds.");
+  }
+  offset -= 1;
+  // view of the view refers to the original vector
+  if (ALTREP(x) && R_altrep_inherits(x, raw_view_class) && !raw_view_materialized(x)) {
+    offset += raw_view_offset(x);
+    x = R_altrep_data1(x);
+  }
+  return raw_view_make(x, offset, size);
+}
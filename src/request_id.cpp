@@ -0,0 +1,102 @@
+#include <Rcpp.h>
+#include <chrono>
+#include <cstdint>
+#include <unistd.h>
+
+// UUIDv7 (RFC 9562) request ids:
+// 48 bit unix time in ms | version 7 | 12 bit counter | variant | 22 bit pid | 40 random bits
+// ids are sortable by creation time, the counter keeps them monotonic within
+// a millisecond and the pid bits keep ids of concurrent (forked) workers apart
+class RequestIdGenerator {
+public:
+  RequestIdGenerator() : pid_(-1), state_(0), last_ms_(0), counter_(0) {}
+  void next(char* out) {
+    long pid = static_cast<long>(getpid());
+    if (pid != pid_) {
+      // new process (fork) - forked children must not share PRNG state with the parent
+      seed(pid);
+    }
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count());
+    if (now > last_ms_) {
+      last_ms_ = now;
+      // random start leaves at least 2048 ids per millisecond before overflow
+      counter_ = static_cast<uint32_t>(rand64() & 0x7FF);
+    } else if (++counter_ > 0xFFF) {
+      // counter overflow or clock moved backwards - borrow the next millisecond
+      ++last_ms_;
+      counter_ = 0;
+    }
+    uint64_t hi = (last_ms_ << 16) | 0x7000 | counter_;
+    uint64_t lo = (uint64_t(2) << 62) |
+      (static_cast<uint64_t>(pid & 0x3FFFFF) << 40) |
+      (rand64() & 0xFFFFFFFFFFULL);
+    write_hex(hi, lo, out);
+  }
+private:
+  long pid_;
+  uint64_t state_;
+  uint64_t last_ms_;
+  uint32_t counter_;
+
+  void seed(long pid) {
+    uint64_t t = static_cast<uint64_t>(
+      std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    state_ = t ^ (static_cast<uint64_t>(pid) * 0x9E3779B97F4A7C15ULL) ^
+      static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&t));
+    pid_ = pid;
+    last_ms_ = 0;
+  }
+  // splitmix64
+  uint64_t rand64() {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+  static void write_hex(uint64_t hi, uint64_t lo, char* out) {
+    static const char digits[] = "0123456789abcdef";
+    int k = 0;
+    for (int i = 0; i < 32; ++i) {
+      if (i == 8 || i == 12 || i == 16 || i == 20) {
+        out[k++] = '-';
+      }
+      uint64_t word = i < 16 ? hi : lo;
+      out[k++] = digits[(word >> (60 - 4 * (i % 16))) & 0xF];
+    }
+    out[k] = '\0';
+  }
+};
+
+static RequestIdGenerator request_id_generator;
+
+// incoming ids are accepted only if they can be safely written to logs and headers
+static bool is_valid_request_id(SEXP x) {
+  if (TYPEOF(x) != STRSXP || Rf_xlength(x) != 1 || STRING_ELT(x, 0) == NA_STRING) {
+    return false;
+  }
+  SEXP el = STRING_ELT(x, 0);
+  int n = LENGTH(el);
+  if (n == 0 || n > 200) {
+    return false;
+  }
+  const char* p = CHAR(el);
+  for (int i = 0; i < n; ++i) {
+    if (p[i] < '!' || p[i] > '~') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// returns 'incoming' id (value of the request header) if it is valid
+// or generates a new one
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_request_id(SEXP incoming = R_NilValue) {
+  if (is_valid_request_id(incoming)) {
+    return incoming;
+  }
+  char buf[37];
+  request_id_generator.next(buf);
+  return Rf_mkString(buf);
+}
@@ -0,0 +1,646 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+// Responses of ResponseCacheMiddleware.
+// Entries are kept in the shared memory store (see shared_store.cpp), so the
+// responses cached by any of the forked Rserve children are served by all of
+// them. Entries are keyed by method, path, query parameters (sorted by name)
+// and names and values of the request headers listed in 'Vary' of the stored
+// response. 'Vary' names are kept in a separate store by method + path +
+// query (primary key), so a lookup builds the full key without the response.
+// Entries expire after the TTL of the longest matching route prefix (or
+// 'max-age' / 's-maxage' of the response), least recently used entries are
+// evicted when the store is full.
+
+// parsed Cache-Control directives which matter for the cache
+struct CacheControl {
+  bool no_store = false;
+  bool no_cache = false;
+  bool is_private = false;
+  bool is_public = false;
+  // -1 if not set
+  double max_age = -1;
+  double s_maxage = -1;
+};
+
+static double now_seconds() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool iequals(sv x, const char* y) {
+  std::size_t n = std::strlen(y);
+  if (x.size() != n) {
+    return false;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    if (std::tolower(static_cast<unsigned char>(x[i])) != y[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// header value from the named list, 'name' is compared case insensitively
+// (request headers have lower case names, response headers are as set)
+static SEXP find_header(SEXP headers, const char* name) {
+  SEXP names = Rf_getAttrib(headers, R_NamesSymbol);
+  if (TYPEOF(headers) != VECSXP || TYPEOF(names) != STRSXP) {
+    return R_NilValue;
+  }
+  for (R_xlen_t i = 0; i < Rf_xlength(headers); ++i) {
+    SEXP el = STRING_ELT(names, i);
+    if (iequals(sv(CHAR(el), LENGTH(el)), name)) {
+      SEXP value = VECTOR_ELT(headers, i);
+      return TYPEOF(value) == STRSXP ? value : R_NilValue;
+    }
+  }
+  return R_NilValue;
+}
+
+// calls 'f' for each comma separated token of the header value
+template <typename F>
+static void for_each_token(SEXP value, F f) {
+  if (TYPEOF(value) != STRSXP) {
+    return;
+  }
+  for (R_xlen_t i = 0; i < Rf_xlength(value); ++i) {
+    SEXP el = STRING_ELT(value, i);
+    if (el == NA_STRING) {
+      continue;
+    }
+    sv x(CHAR(el), LENGTH(el));
+    while (!x.empty()) {
+      std::size_t pos = x.find(',');
+      sv token = sv_trim(x.substr(0, pos));
+      x = pos == sv::npos ? sv() : x.substr(pos + 1);
+      if (!token.empty()) {
+        f(token);
+      }
+    }
+  }
+}
+
+static double directive_seconds(sv x) {
+  x = sv_trim(x);
+  if (!x.empty() && x[0] == '"') {
+    x = x.substr(1, x.size() >= 2 ? x.size() - 2 : 0);
+  }
+  if (x.empty()) {
+    return -1;
+  }
+  double res = 0;
+  for (char c : x) {
+    if (c < '0' || c > '9') {
+      return -1;
+    }
+    res = res * 10 + (c - '0');
+  }
+  return res;
+}
+
+static CacheControl parse_cache_control(SEXP value) {
+  CacheControl res;
+  for_each_token(value, [&res](sv token) {
+    std::size_t eq = token.find('=');
+    sv name = sv_trim(token.substr(0, eq));
+    sv arg = eq == sv::npos ? sv() : token.substr(eq + 1);
+    if (iequals(name, "no-store")) {
+      res.no_store = true;
+    } else if (iequals(name, "no-cache")) {
+      res.no_cache = true;
+    } else if (iequals(name, "private")) {
+      res.is_private = true;
+    } else if (iequals(name, "public")) {
+      res.is_public = true;
+    } else if (iequals(name, "max-age")) {
+      res.max_age = directive_seconds(arg);
+    } else if (iequals(name, "s-maxage")) {
+      res.s_maxage = directive_seconds(arg);
+    }
+  });
+  return res;
+}
+
+// appends length prefixed string, so different parts never collide
+static void append_part(std::string& key, const char* x, std::size_t n) {
+  key.append(std::to_string(static_cast<unsigned long long>(n)));
+  key.push_back(':');
+  key.append(x, n);
+}
+
+// stored values are serialized natively: NULL, raw, character, integer,
+// double and logical vectors and lists, with names
+enum ValueType : uint8_t {
+  VALUE_NULL = 0,
+  VALUE_RAW = 1,
+  VALUE_STRING = 2,
+  VALUE_INTEGER = 3,
+  VALUE_DOUBLE = 4,
+  VALUE_LOGICAL = 5,
+  VALUE_LIST = 6
+};
+
+static const uint32_t na_size = 0xFFFFFFFF;
+// requests with longer keys (path, query, 'Vary' headers) are not cached
+static const std::size_t max_key_size = 4096;
+static const std::size_t max_headers_size = 16384;
+static const std::size_t max_vary_size = 1024;
+
+template <typename T>
+static void put(std::string& out, T x) {
+  out.append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+static bool put_value(std::string& out, SEXP x) {
+  uint8_t type;
+  switch (TYPEOF(x)) {
+  case NILSXP: type = VALUE_NULL; break;
+  case RAWSXP: type = VALUE_RAW; break;
+  case STRSXP: type = VALUE_STRING; break;
+  case INTSXP: type = VALUE_INTEGER; break;
+  case REALSXP: type = VALUE_DOUBLE; break;
+  case LGLSXP: type = VALUE_LOGICAL; break;
+  case VECSXP: type = VALUE_LIST; break;
+  default: return false;
+  }
+  put(out, type);
+  if (type == VALUE_NULL) {
+    return true;
+  }
+  R_xlen_t n = Rf_xlength(x);
+  put(out, static_cast<uint64_t>(n));
+  switch (type) {
+  case VALUE_RAW:
+    out.append(reinterpret_cast<const char*>(RAW(x)), n);
+    break;
+  case VALUE_INTEGER:
+    out.append(reinterpret_cast<const char*>(INTEGER(x)), n * sizeof(int));
+    break;
+  case VALUE_LOGICAL:
+    out.append(reinterpret_cast<const char*>(LOGICAL(x)), n * sizeof(int));
+    break;
+  case VALUE_DOUBLE:
+    out.append(reinterpret_cast<const char*>(REAL(x)), n * sizeof(double));
+    break;
+  case VALUE_STRING:
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SEXP el = STRING_ELT(x, i);
+      if (el == NA_STRING) {
+        put(out, na_size);
+        continue;
+      }
+      put(out, static_cast<uint32_t>(LENGTH(el)));
+      put(out, static_cast<uint8_t>(Rf_getCharCE(el)));
+      out.append(CHAR(el), LENGTH(el));
+    }
+    break;
+  case VALUE_LIST:
+    for (R_xlen_t i = 0; i < n; ++i) {
+      if (!put_value(out, VECTOR_ELT(x, i))) {
+        return false;
+      }
+    }
+    break;
+  }
+  return put_value(out, Rf_getAttrib(x, R_NamesSymbol));
+}
+
+// strings are written as is, other values (typed query parameters, see
+// 'RestRserve.query.types') are serialized, so 'id=1' and 'id=2' never
+// share the key. Returns FALSE for values which can't be a part of the key
+static bool append_values(std::string& key, SEXP value) {
+  if (TYPEOF(value) != STRSXP) {
+    key.push_back('#');
+    return put_value(key, value);
+  }
+  key.append(std::to_string(static_cast<long long>(Rf_xlength(value))));
+  key.push_back('[');
+  for (R_xlen_t i = 0; i < Rf_xlength(value); ++i) {
+    SEXP el = STRING_ELT(value, i);
+    if (el == NA_STRING) {
+      key.push_back('!');
+    } else {
+      append_part(key, CHAR(el), LENGTH(el));
+    }
+  }
+  return true;
+}
+
+class ValueReader {
+public:
+  ValueReader(const std::string& x) : p_(x.data()), end_(x.data() + x.size()) {}
+
+  template <typename T>
+  T get() {
+    T x;
+    std::memcpy(&x, take(sizeof(T)), sizeof(T));
+    return x;
+  }
+
+  // returned object is not protected
+  SEXP value() {
+    uint8_t type = get<uint8_t>();
+    if (type == VALUE_NULL) {
+      return R_NilValue;
+    }
+    uint64_t n = get<uint64_t>();
+    if (n > static_cast<uint64_t>(end_ - p_)) {
+      corrupted();
+    }
+    SEXP res;
+    switch (type) {
+    case VALUE_RAW:
+      res = PROTECT(Rf_allocVector(RAWSXP, n));
+      std::memcpy(RAW(res), take(n), n);
+      break;
+    case VALUE_INTEGER:
+      res = PROTECT(Rf_allocVector(INTSXP, n));
+      std::memcpy(INTEGER(res), take(n * sizeof(int)), n * sizeof(int));
+      break;
+    case VALUE_LOGICAL:
+      res = PROTECT(Rf_allocVector(LGLSXP, n));
+      std::memcpy(LOGICAL(res), take(n * sizeof(int)), n * sizeof(int));
+      break;
+    case VALUE_DOUBLE:
+      res = PROTECT(Rf_allocVector(REALSXP, n));
+      std::memcpy(REAL(res), take(n * sizeof(double)), n * sizeof(double));
+      break;
+    case VALUE_STRING:
+      res = PROTECT(Rf_allocVector(STRSXP, n));
+      for (uint64_t i = 0; i < n; ++i) {
+        uint32_t size = get<uint32_t>();
+        if (size == na_size) {
+          SET_STRING_ELT(res, i, NA_STRING);
+          continue;
+        }
+        cetype_t enc = static_cast<cetype_t>(get<uint8_t>());
+        const char* data = take(size);
+        SET_STRING_ELT(res, i, Rf_mkCharLenCE(data, static_cast<int>(size), enc));
+      }
+      break;
+    case VALUE_LIST:
+      res = PROTECT(Rf_allocVector(VECSXP, n));
+      for (uint64_t i = 0; i < n; ++i) {
+        SET_VECTOR_ELT(res, i, value());
+      }
+      break;
+    default:
+      corrupted();
+    }
+    SEXP names = value();
+    if (names != R_NilValue) {
+      Rf_setAttrib(res, R_NamesSymbol, names);
+    }
+    UNPROTECT(1);
+    return res;
+  }
+
+private:
+  const char* p_;
+  const char* end_;
+
+  const char* take(std::size_t n) {
+    if (n > static_cast<std::size_t>(end_ - p_)) {
+      corrupted();
+    }
+    const char* res = p_;
+    p_ += n;
+    return res;
+  }
+
+  [[noreturn]] static void corrupted() {
+    Rcpp::stop("Response cache entry is corrupted.");
+  }
+};
+
+class ResponseCache {
+public:
+  ResponseCache(SharedStore* entries, SharedStore* vary, double max_entry_size,
+                std::vector<std::string> ttl_routes, std::vector<double> ttl) :
+    entries_(entries), vary_(vary), max_entry_size_(max_entry_size),
+    ttl_routes_(std::move(ttl_routes)), ttl_(std::move(ttl)) {}
+
+  ~ResponseCache() {
+    shared_store_free(entries_);
+    shared_store_free(vary_);
+  }
+
+  // returns list(status_code, body, content_type, headers) of the fresh
+  // entry ('Age' header is added) or NULL
+  SEXP get(const std::string& method, const std::string& path, SEXP query, SEXP headers) {
+    CacheControl cc = parse_cache_control(find_header(headers, "cache-control"));
+    if (cc.no_store || cc.no_cache || cc.max_age == 0 || pragma_no_cache(headers)) {
+      return miss();
+    }
+    std::string primary = primary_key(method, path, query);
+    if (primary.empty() || !shared_store_get(vary_, primary, buf_)) {
+      return miss();
+    }
+    std::vector<std::string> vary;
+    str_split(buf_, vary, '\n', false);
+    if (!authorization_allowed(vary, headers)) {
+      return miss();
+    }
+    std::string key = full_key(primary, vary, headers);
+    if (key.empty() || !shared_store_get(entries_, key, buf_)) {
+      return miss();
+    }
+    ValueReader reader(buf_);
+    double age = std::floor(std::max(0.0, now_seconds() - reader.get<double>()));
+    if (cc.max_age > 0 && age > cc.max_age) {
+      return miss();
+    }
+    shared_store_count(entries_, true);
+    SEXP value = PROTECT(reader.value());
+    SEXP res = with_age(value, age);
+    UNPROTECT(1);
+    return res;
+  }
+
+  // stores the response if it is cacheable, returns TRUE if it was stored
+  bool set(const std::string& method, const std::string& path, SEXP query, SEXP req_headers,
+           SEXP status_code, SEXP body, SEXP content_type, SEXP headers) {
+    CacheControl req_cc = parse_cache_control(find_header(req_headers, "cache-control"));
+    CacheControl cc = parse_cache_control(find_header(headers, "cache-control"));
+    if (req_cc.no_store || cc.no_store || cc.no_cache || cc.is_private) {
+      return false;
+    }
+    double ttl = cc.s_maxage >= 0 ? cc.s_maxage : (cc.max_age >= 0 ? cc.max_age : route_ttl(path));
+    if (!(ttl > 0)) {
+      return false;
+    }
+    double bytes;
+    if (!body_size(body, bytes) || bytes > max_entry_size_) {
+      return false;
+    }
+    std::vector<std::string> vary;
+    bool vary_any = false;
+    for_each_token(find_header(headers, "vary"), [&vary, &vary_any](sv token) {
+      if (token == "*") {
+        vary_any = true;
+      }
+      std::string name(token.data(), token.size());
+      str_lower(name);
+      vary.push_back(std::move(name));
+    });
+    if (vary_any) {
+      return false;
+    }
+    std::sort(vary.begin(), vary.end());
+    vary.erase(std::unique(vary.begin(), vary.end()), vary.end());
+    // authorized responses are shared only if they depend on the credentials
+    // or are explicitly public
+    if (!cc.is_public && cc.s_maxage < 0 && !authorization_allowed(vary, req_headers)) {
+      return false;
+    }
+
+    static const char* names[] = {"status_code", "body", "content_type", "headers", ""};
+    SEXP value = PROTECT(Rf_mkNamed(VECSXP, names));
+    SET_VECTOR_ELT(value, 0, status_code);
+    SET_VECTOR_ELT(value, 1, body);
+    SET_VECTOR_ELT(value, 2, content_type);
+    SET_VECTOR_ELT(value, 3, headers);
+    buf_.clear();
+    put(buf_, now_seconds());
+    bool ok = put_value(buf_, value);
+    UNPROTECT(1);
+    std::string primary = primary_key(method, path, query);
+    std::string key = primary.empty() ? primary : full_key(primary, vary, req_headers);
+    // entries with other 'Vary' names are not reachable anymore and expire
+    if (!ok || key.empty() || !shared_store_set(entries_, key, buf_, ttl)) {
+      return false;
+    }
+    std::string vary_names;
+    for (const auto& name : vary) {
+      if (!vary_names.empty()) {
+        vary_names.push_back('\n');
+      }
+      vary_names.append(name);
+    }
+    return shared_store_set(vary_, primary, vary_names, ttl);
+  }
+
+  void clear() {
+    shared_store_clear(entries_);
+    shared_store_clear(vary_);
+  }
+
+  SEXP info() const {
+    return shared_store_info(entries_);
+  }
+
+private:
+  SharedStore* entries_;
+  SharedStore* vary_;
+  double max_entry_size_;
+  // route prefixes and their TTLs, "" is the default
+  std::vector<std::string> ttl_routes_;
+  std::vector<double> ttl_;
+  std::string buf_;
+
+  SEXP miss() {
+    shared_store_count(entries_, false);
+    return R_NilValue;
+  }
+
+  // TTL of the longest matching route prefix
+  double route_ttl(const std::string& path) const {
+    double res = 0;
+    std::size_t best = 0;
+    bool found = false;
+    for (std::size_t i = 0; i < ttl_routes_.size(); ++i) {
+      const std::string& route = ttl_routes_[i];
+      if ((!found || route.size() > best) && str_starts_with(path, route)) {
+        res = ttl_[i];
+        best = route.size();
+        found = true;
+      }
+    }
+    return res;
+  }
+
+  static bool pragma_no_cache(SEXP headers) {
+    bool res = false;
+    for_each_token(find_header(headers, "pragma"), [&res](sv token) {
+      res = res || iequals(token, "no-cache");
+    });
+    return res;
+  }
+
+  static bool authorization_allowed(const std::vector<std::string>& vary, SEXP headers) {
+    return find_header(headers, "authorization") == R_NilValue ||
+      std::find(vary.begin(), vary.end(), std::string("authorization")) != vary.end();
+  }
+
+  // only encoded bodies are stored: raw, character (including file paths)
+  // or NULL, temporary files are removed after they are sent
+  static bool body_size(SEXP body, double& res) {
+    res = 0;
+    if (body == R_NilValue) {
+      return true;
+    }
+    if (TYPEOF(body) == RAWSXP) {
+      res = static_cast<double>(XLENGTH(body));
+      return true;
+    }
+    if (TYPEOF(body) != STRSXP) {
+      return false;
+    }
+    SEXP names = Rf_getAttrib(body, R_NamesSymbol);
+    if (TYPEOF(names) == STRSXP && Rf_xlength(names) > 0 &&
+        std::strcmp(CHAR(STRING_ELT(names, 0)), "tmpfile") == 0) {
+      return false;
+    }
+    for (R_xlen_t i = 0; i < Rf_xlength(body); ++i) {
+      SEXP el = STRING_ELT(body, i);
+      if (el != NA_STRING) {
+        res += LENGTH(el);
+      }
+    }
+    return true;
+  }
+
+  // method, path and query parameters sorted by name (values keep their order),
+  // empty if the request can't be cached
+  static std::string primary_key(const std::string& method, const std::string& path, SEXP query) {
+    std::string key;
+    append_part(key, method.data(), method.size());
+    append_part(key, path.data(), path.size());
+    SEXP names = Rf_getAttrib(query, R_NamesSymbol);
+    if (TYPEOF(query) == VECSXP && TYPEOF(names) == STRSXP && Rf_xlength(query) > 0) {
+      R_xlen_t n = Rf_xlength(query);
+      std::vector<R_xlen_t> order(n);
+      for (R_xlen_t i = 0; i < n; ++i) {
+        order[i] = i;
+      }
+      std::stable_sort(order.begin(), order.end(), [names](R_xlen_t a, R_xlen_t b) {
+        return std::strcmp(CHAR(STRING_ELT(names, a)), CHAR(STRING_ELT(names, b))) < 0;
+      });
+      for (R_xlen_t i : order) {
+        SEXP name = STRING_ELT(names, i);
+        append_part(key, CHAR(name), LENGTH(name));
+        if (!append_values(key, VECTOR_ELT(query, i))) {
+          return std::string();
+        }
+      }
+    }
+    return key;
+  }
+
+  // 'Vary' names are a part of the key, so the entries stored with other
+  // names are never matched
+  static std::string full_key(const std::string& primary, const std::vector<std::string>& vary,
+                              SEXP headers) {
+    std::string key = primary;
+    for (const auto& name : vary) {
+      key.push_back('|');
+      append_part(key, name.data(), name.size());
+      if (!append_values(key, find_header(headers, name.c_str()))) {
+        return std::string();
+      }
+    }
+    return key;
+  }
+
+  static SEXP with_age(SEXP value, double age) {
+    SEXP headers = VECTOR_ELT(value, 3);
+    SEXP names = Rf_getAttrib(headers, R_NamesSymbol);
+    R_xlen_t n = Rf_xlength(headers);
+    SEXP new_headers = PROTECT(Rf_allocVector(VECSXP, n + 1));
+    SEXP new_names = PROTECT(Rf_allocVector(STRSXP, n + 1));
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SET_VECTOR_ELT(new_headers, i, VECTOR_ELT(headers, i));
+      SET_STRING_ELT(new_names, i, TYPEOF(names) == STRSXP ? STRING_ELT(names, i) : R_BlankString);
+    }
+    SET_VECTOR_ELT(new_headers, n, Rf_mkString(std::to_string(static_cast<long long>(age)).c_str()));
+    SET_STRING_ELT(new_names, n, Rf_mkChar("Age"));
+    Rf_setAttrib(new_headers, R_NamesSymbol, new_names);
+    SET_VECTOR_ELT(value, 3, new_headers);
+    UNPROTECT(2);
+    return value;
+  }
+};
+
+static void response_cache_finalizer(SEXP ptr) {
+  ResponseCache* cache = static_cast<ResponseCache*>(R_ExternalPtrAddr(ptr));
+  if (cache != nullptr) {
+    delete cache;
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+static ResponseCache* get_cache(SEXP ptr) {
+  if (TYPEOF(ptr) != EXTPTRSXP || R_ExternalPtrAddr(ptr) == nullptr) {
+    Rcpp::stop("Response cache is not initialized.");
+  }
+  return static_cast<ResponseCache*>(R_ExternalPtrAddr(ptr));
+}
+
+// 'capacity' - number of entries, 'max_size' - total size of the stored
+// responses, 'ttl' - TTL (seconds) of the routes prefixes (names), "" name is
+// the default
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_response_cache_new(double capacity, double max_entry_size, double max_size,
+                            Rcpp::NumericVector ttl) {
+  std::vector<std::string> routes;
+  std::vector<double> values;
+  SEXP names = Rf_getAttrib(ttl, R_NamesSymbol);
+  for (R_xlen_t i = 0; i < ttl.size(); ++i) {
+    routes.emplace_back(TYPEOF(names) == STRSXP ? CHAR(STRING_ELT(names, i)) : "");
+    values.push_back(ttl[i]);
+  }
+  std::size_t n = static_cast<std::size_t>(capacity);
+  // status code, content type and headers are stored along with the body
+  std::size_t max_value_size = static_cast<std::size_t>(max_entry_size) + max_headers_size;
+  SharedStore* entries = shared_store_new(n, max_key_size, max_value_size, 64,
+                                          static_cast<std::size_t>(max_size));
+  if (entries == nullptr) {
+    Rcpp::stop("Can't map shared memory for the response cache: %s.", std::strerror(errno));
+  }
+  SharedStore* vary = shared_store_new(n, max_key_size, max_vary_size, 64);
+  if (vary == nullptr) {
+    shared_store_free(entries);
+    Rcpp::stop("Can't map shared memory for the response cache: %s.", std::strerror(errno));
+  }
+  ResponseCache* cache = new ResponseCache(entries, vary, max_entry_size, routes, values);
+  SEXP ptr = PROTECT(R_MakeExternalPtr(cache, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, response_cache_finalizer, TRUE);
+  UNPROTECT(1);
+  return ptr;
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_response_cache_get(SEXP ptr, const std::string& method, const std::string& path,
+                            SEXP query, SEXP headers) {
+  return get_cache(ptr)->get(method, path, query, headers);
+}
+
+// [[Rcpp::export(rng=false)]]
+bool cpp_response_cache_set(SEXP ptr, const std::string& method, const std::string& path,
+                            SEXP query, SEXP req_headers, SEXP status_code, SEXP body,
+                            SEXP content_type, SEXP headers) {
+  return get_cache(ptr)->set(method, path, query, req_headers, status_code, body,
+                             content_type, headers);
+}
+
+// [[Rcpp::export(rng=false)]]
+void cpp_response_cache_clear(SEXP ptr) {
+  get_cache(ptr)->clear();
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_response_cache_info(SEXP ptr) {
+  return get_cache(ptr)->info();
+}
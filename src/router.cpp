@@ -0,0 +1,582 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+// Routes are compiled into a tree of path segments:
+// * 'exact' paths are looked up in a hash map;
+// * 'partial' prefixes and 'regex' templates share the tree, each node is a
+//   segment, template variables are edges which accept a non-empty segment
+//   of the declared type.
+// Matching is a single depth-first walk over the path segments, literal
+// segments take priority over variables (typed variables are tried before
+// 'character' ones) and templates take priority over prefixes ending at the
+// same node, the walk backtracks if the branch can't be completed.
+
+// path variable types, declared as '{name:type}'
+// any other type is a regular expression which must match the whole segment
+enum class ParamKind { INTEGER, LOGICAL, UUID, NUMERIC, REGEX, CHARACTER };
+
+static ParamKind param_kind(const std::string& type) {
+  if (type == "character") return ParamKind::CHARACTER;
+  if (type == "integer") return ParamKind::INTEGER;
+  if (type == "numeric") return ParamKind::NUMERIC;
+  if (type == "logical") return ParamKind::LOGICAL;
+  if (type == "uuid") return ParamKind::UUID;
+  return ParamKind::REGEX;
+}
+
+static bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static bool is_hex(char c) {
+  return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// optional sign and digits, NA_integer_ is not a valid value
+static bool parse_int(sv x, int& res) {
+  std::size_t i = 0;
+  bool negative = false;
+  if (!x.empty() && (x[0] == '-' || x[0] == '+')) {
+    negative = x[0] == '-';
+    i = 1;
+  }
+  if (i == x.size()) {
+    return false;
+  }
+  long long value = 0;
+  for (; i < x.size(); ++i) {
+    if (!is_digit(x[i])) {
+      return false;
+    }
+    value = value * 10 + (x[i] - '0');
+    if (value > INT_MAX) {
+      return false;
+    }
+  }
+  res = static_cast<int>(negative ? -value : value);
+  return true;
+}
+
+// decimal number: [+-]digits[.digits][e[+-]digits], no 'Inf' or 'NaN'
+static bool parse_double(sv x, double& res) {
+  std::size_t i = 0, n = x.size();
+  if (i < n && (x[i] == '-' || x[i] == '+')) ++i;
+  std::size_t digits = 0;
+  while (i < n && is_digit(x[i])) { ++i; ++digits; }
+  if (i < n && x[i] == '.') {
+    ++i;
+    while (i < n && is_digit(x[i])) { ++i; ++digits; }
+  }
+  if (digits == 0) {
+    return false;
+  }
+  if (i < n && (x[i] == 'e' || x[i] == 'E')) {
+    ++i;
+    if (i < n && (x[i] == '-' || x[i] == '+')) ++i;
+    std::size_t exp_digits = 0;
+    while (i < n && is_digit(x[i])) { ++i; ++exp_digits; }
+    if (exp_digits == 0) {
+      return false;
+    }
+  }
+  if (i != n) {
+    return false;
+  }
+  std::string buf(x.data(), x.size());
+  res = std::strtod(buf.c_str(), nullptr);
+  return true;
+}
+
+// same values as as.logical() accepts
+static bool parse_logical(sv x, int& res) {
+  if (x == "TRUE" || x == "true" || x == "True" || x == "T") {
+    res = 1;
+    return true;
+  }
+  if (x == "FALSE" || x == "false" || x == "False" || x == "F") {
+    res = 0;
+    return true;
+  }
+  return false;
+}
+
+// 8-4-4-4-12 hex digits
+static bool is_uuid(sv x) {
+  if (x.size() != 36) {
+    return false;
+  }
+  for (std::size_t i = 0; i < 36; ++i) {
+    if (i == 8 || i == 13 || i == 18 || i == 23) {
+      if (x[i] != '-') return false;
+    } else if (!is_hex(x[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// regular expression types are matched by R's engine (TRE, as grepl() in the
+// R router did): std::regex recurses per character, so a long segment sent
+// by the client could exhaust the stack.
+// Returns FALSE if 'pattern' is invalid
+static bool grepl_segment(const std::string& pattern, sv x, bool& matched) {
+  SEXP re = PROTECT(Rf_mkString(("^(" + pattern + ")$").c_str()));
+  SEXP value = PROTECT(Rf_ScalarString(Rf_mkCharLenCE(x.data(), x.size(), CE_UTF8)));
+  SEXP call = PROTECT(Rf_lang3(Rf_install("grepl"), re, value));
+  // invalid patterns also raise a warning
+  call = PROTECT(Rf_lang2(Rf_install("suppressWarnings"), call));
+  int err = 0;
+  SEXP res = R_tryEvalSilent(call, R_BaseEnv, &err);
+  matched = !err && TYPEOF(res) == LGLSXP && Rf_xlength(res) == 1 && LOGICAL(res)[0] == TRUE;
+  UNPROTECT(4);
+  return err == 0;
+}
+
+struct RouteNode;
+
+struct ParamEdge {
+  std::string type;
+  ParamKind kind;
+  std::unique_ptr<RouteNode> node;
+
+  bool accepts(sv x) const {
+    int i;
+    double d;
+    bool b;
+    switch (kind) {
+      case ParamKind::CHARACTER: return true;
+      case ParamKind::INTEGER: return parse_int(x, i);
+      case ParamKind::NUMERIC: return parse_double(x, d);
+      case ParamKind::LOGICAL: return parse_logical(x, i);
+      case ParamKind::UUID: return is_uuid(x);
+      case ParamKind::REGEX: return grepl_segment(type, x, b) && b;
+    }
+    return false;
+  }
+
+  // value coerced to the declared type
+  SEXP value(sv x) const {
+    int i = NA_INTEGER;
+    double d = NA_REAL;
+    switch (kind) {
+      case ParamKind::INTEGER:
+        parse_int(x, i);
+        return Rf_ScalarInteger(i);
+      case ParamKind::NUMERIC:
+        parse_double(x, d);
+        return Rf_ScalarReal(d);
+      case ParamKind::LOGICAL:
+        parse_logical(x, i);
+        return Rf_ScalarLogical(i);
+      default:
+        return Rf_ScalarString(Rf_mkCharLenCE(x.data(), x.size(), CE_UTF8));
+    }
+  }
+};
+
+struct RouteNode {
+  // sorted by segment for binary search
+  std::vector<std::pair<std::string, std::unique_ptr<RouteNode>>> children;
+  std::vector<ParamEdge> params;
+  // 'partial' route which ends at this node
+  bool has_prefix = false;
+  std::string prefix_id;
+  // 'regex' route which ends at this node
+  bool has_template = false;
+  std::string template_id;
+  std::vector<std::string> names;
+
+  RouteNode* find_child(sv segment) const {
+    auto it = std::lower_bound(
+      children.begin(), children.end(), segment,
+      [](const std::pair<std::string, std::unique_ptr<RouteNode>>& x, sv y) {
+        return sv(x.first) < y;
+      }
+    );
+    if (it != children.end() && sv(it->first) == segment) {
+      return it->second.get();
+    }
+    return nullptr;
+  }
+
+  RouteNode* add_child(sv segment) {
+    auto it = std::lower_bound(
+      children.begin(), children.end(), segment,
+      [](const std::pair<std::string, std::unique_ptr<RouteNode>>& x, sv y) {
+        return sv(x.first) < y;
+      }
+    );
+    if (it != children.end() && sv(it->first) == segment) {
+      return it->second.get();
+    }
+    it = children.emplace(it, std::string(segment.data(), segment.size()),
+                          std::unique_ptr<RouteNode>(new RouteNode()));
+    return it->second.get();
+  }
+
+  // edges are kept ordered by kind, so more specific types are tried first
+  RouteNode* add_param(const std::string& type) {
+    for (auto& edge : params) {
+      if (edge.type == type) {
+        return edge.node.get();
+      }
+    }
+    ParamEdge edge;
+    edge.type = type;
+    edge.kind = param_kind(type);
+    bool matched;
+    if (edge.kind == ParamKind::REGEX && !grepl_segment(type, sv(""), matched)) {
+      Rcpp::stop("Invalid path variable type or regular expression '%s'.", type);
+    }
+    edge.node.reset(new RouteNode());
+    auto it = std::upper_bound(
+      params.begin(), params.end(), edge.kind,
+      [](ParamKind x, const ParamEdge& y) { return x < y.kind; }
+    );
+    it = params.insert(it, std::move(edge));
+    return it->node.get();
+  }
+};
+
+struct RouteMatch {
+  const std::string* id = nullptr;
+  const std::vector<std::string>* names = nullptr;
+  std::vector<sv> values;
+  std::vector<const ParamEdge*> edges;
+};
+
+// splits '/a/b/c' into segments, empty segments are kept
+static std::vector<sv> split_path(sv path) {
+  std::vector<sv> res;
+  if (path.empty() || path.front() != '/') {
+    return res;
+  }
+  path.remove_prefix(1);
+  while (true) {
+    std::size_t pos = path.find('/');
+    if (pos == sv::npos) {
+      res.push_back(path);
+      break;
+    }
+    res.push_back(path.substr(0, pos));
+    path.remove_prefix(pos + 1);
+  }
+  return res;
+}
+
+class RouteTree {
+public:
+  void add_exact(const std::string& path, const std::string& id) {
+    if (!exact_.emplace(path, id).second) {
+      Rcpp::stop("Path already exists.");
+    }
+  }
+
+  // 'path' is a prefix with the trailing '/'
+  void add_prefix(const std::string& path, const std::string& id) {
+    RouteNode* node = &root_;
+    std::vector<sv> segments = split_path(path);
+    // last segment is empty - prefix ends with '/'
+    for (std::size_t i = 0; i + 1 < segments.size(); ++i) {
+      node = node->add_child(segments[i]);
+    }
+    if (node->has_prefix) {
+      Rcpp::stop("Prefix already exists.");
+    }
+    node->has_prefix = true;
+    node->prefix_id = id;
+  }
+
+  // 'pos' are 1-based positions of the variables segments
+  void add_template(const std::string& path, const std::string& id,
+                    const std::vector<std::string>& names,
+                    const std::vector<std::string>& types,
+                    const std::vector<int>& pos) {
+    RouteNode* node = &root_;
+    std::vector<sv> segments = split_path(path);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+      if (k < pos.size() && static_cast<std::size_t>(pos[k]) == i + 1) {
+        node = node->add_param(types[k]);
+        ++k;
+      } else {
+        node = node->add_child(segments[i]);
+      }
+    }
+    if (node->has_template) {
+      Rcpp::stop("Regex already exists.");
+    }
+    node->has_template = true;
+    node->template_id = id;
+    node->names = names;
+  }
+
+  bool match(const std::string& path, RouteMatch& res) const {
+    auto it = exact_.find(path);
+    if (it != exact_.end()) {
+      res.id = &it->second;
+      return true;
+    }
+    std::vector<sv> segments = split_path(path);
+    if (segments.empty()) {
+      return false;
+    }
+    return walk(&root_, segments, 0, res);
+  }
+
+private:
+  std::unordered_map<std::string, std::string> exact_;
+  RouteNode root_;
+
+  // 'i' is the index of the next segment, all segments before are consumed
+  // and followed by '/'
+  bool walk(const RouteNode* node, const std::vector<sv>& segments,
+            std::size_t i, RouteMatch& res) const {
+    std::size_t n = segments.size();
+    // templates allow single trailing '/'
+    if (node->has_template && (i == n || (i + 1 == n && segments[i].empty()))) {
+      res.id = &node->template_id;
+      res.names = &node->names;
+      return true;
+    }
+    if (i < n) {
+      const RouteNode* child = node->find_child(segments[i]);
+      if (child != nullptr && walk(child, segments, i + 1, res)) {
+        return true;
+      }
+      if (!segments[i].empty()) {
+        for (const auto& edge : node->params) {
+          if (!edge.accepts(segments[i])) {
+            continue;
+          }
+          res.values.push_back(segments[i]);
+          res.edges.push_back(&edge);
+          if (walk(edge.node.get(), segments, i + 1, res)) {
+            return true;
+          }
+          res.values.pop_back();
+          res.edges.pop_back();
+        }
+      }
+      if (node->has_prefix) {
+        res.id = &node->prefix_id;
+        res.names = nullptr;
+        res.values.clear();
+        res.edges.clear();
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+static void router_finalizer(SEXP ptr) {
+  RouteTree* tree = static_cast<RouteTree*>(R_ExternalPtrAddr(ptr));
+  if (tree != nullptr) {
+    delete tree;
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+static RouteTree* get_tree(SEXP ptr) {
+  if (TYPEOF(ptr) != EXTPTRSXP || R_ExternalPtrAddr(ptr) == nullptr) {
+    Rcpp::stop("Router is not initialized.");
+  }
+  return static_cast<RouteTree*>(R_ExternalPtrAddr(ptr));
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_router_new() {
+  SEXP ptr = PROTECT(R_MakeExternalPtr(new RouteTree(), R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, router_finalizer, TRUE);
+  UNPROTECT(1);
+  return ptr;
+}
+
+// 'names', 'types' and 'pos' describe template variables (used for 'regex' only)
+// [[Rcpp::export(rng=false)]]
+void cpp_router_add(SEXP ptr, const std::string& path, const std::string& match,
+                    const std::string& id,
+                    std::vector<std::string> names,
+                    std::vector<std::string> types,
+                    std::vector<int> pos) {
+  RouteTree* tree = get_tree(ptr);
+  if (match == "exact") {
+    tree->add_exact(path, id);
+  } else if (match == "partial") {
+    tree->add_prefix(path, id);
+  } else if (match == "regex") {
+    if (names.size() != pos.size() || types.size() != pos.size()) {
+      Rcpp::stop("'names', 'types' and 'pos' must have the same length.");
+    }
+    tree->add_template(path, id, names, types, pos);
+  } else {
+    Rcpp::stop("unknown match type '%s'.", match);
+  }
+}
+
+// returns handler id with 'parameters_path' attribute or NULL if path is not matched
+// values of typed variables are coerced to integer, double or logical
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_router_match(SEXP ptr, const std::string& path, bool extract_vars = true) {
+  const RouteTree* tree = get_tree(ptr);
+  RouteMatch m;
+  if (!tree->match(path, m)) {
+    return R_NilValue;
+  }
+  SEXP res = PROTECT(Rf_mkString(m.id->c_str()));
+  if (extract_vars && m.names != nullptr) {
+    R_xlen_t n = m.values.size();
+    SEXP vars = PROTECT(Rf_allocVector(VECSXP, n));
+    SEXP vars_names = PROTECT(Rf_allocVector(STRSXP, n));
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SET_VECTOR_ELT(vars, i, m.edges[i]->value(m.values[i]));
+      SET_STRING_ELT(vars_names, i, Rf_mkCharCE((*m.names)[i].c_str(), CE_UTF8));
+    }
+    Rf_setAttrib(vars, R_NamesSymbol, vars_names);
+    Rf_setAttrib(res, Rf_install("parameters_path"), vars);
+    UNPROTECT(2);
+  }
+  UNPROTECT(1);
+  return res;
+}
+
+// Set of exact paths and string prefixes used to scope middleware to routes.
+// Prefixes are matched as is (not by segments), '/api' matches '/apiv2' too.
+class RouteSet {
+public:
+  RouteSet() : nodes_(1) {}
+
+  void add_exact(const std::string& path) {
+    exact_.insert(path);
+  }
+
+  void add_prefix(const std::string& prefix) {
+    std::size_t node = 0;
+    for (char c : prefix) {
+      std::size_t next = find(node, c);
+      if (next == 0) {
+        next = nodes_.size();
+        nodes_[node].next.emplace_back(c, next);
+        nodes_.emplace_back();
+      }
+      node = next;
+    }
+    nodes_[node].end = true;
+  }
+
+  bool match(const std::string& path) const {
+    return match_prefix(path) || match_exact(path);
+  }
+
+  bool match_exact(const std::string& path) const {
+    return !exact_.empty() && exact_.find(path) != exact_.end();
+  }
+
+  // single walk over the path characters
+  bool match_prefix(const std::string& path) const {
+    if (nodes_[0].end) {
+      return true;
+    }
+    std::size_t node = 0;
+    for (char c : path) {
+      node = find(node, c);
+      if (node == 0) {
+        break;
+      }
+      if (nodes_[node].end) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct TrieNode {
+    std::vector<std::pair<char, std::size_t>> next;
+    bool end = false;
+  };
+  std::vector<TrieNode> nodes_;
+  std::unordered_set<std::string> exact_;
+
+  // 0 (root) means there is no such child
+  std::size_t find(std::size_t node, char c) const {
+    for (const auto& x : nodes_[node].next) {
+      if (x.first == c) {
+        return x.second;
+      }
+    }
+    return 0;
+  }
+};
+
+static void route_set_finalizer(SEXP ptr) {
+  RouteSet* set = static_cast<RouteSet*>(R_ExternalPtrAddr(ptr));
+  if (set != nullptr) {
+    delete set;
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+// 'partial' is TRUE for prefixes
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_route_set_new(SEXP routes, SEXP partial) {
+  if (TYPEOF(routes) != STRSXP || TYPEOF(partial) != LGLSXP) {
+    Rcpp::stop("'routes' must be character and 'partial' must be logical.");
+  }
+  R_xlen_t n = Rf_xlength(routes);
+  if (Rf_xlength(partial) != n) {
+    Rcpp::stop("'routes' and 'partial' must have the same length.");
+  }
+  RouteSet* set = new RouteSet();
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SEXP el = STRING_ELT(routes, i);
+    std::string route(CHAR(el), LENGTH(el));
+    if (LOGICAL(partial)[i] == TRUE) {
+      set->add_prefix(route);
+    } else {
+      set->add_exact(route);
+    }
+  }
+  SEXP ptr = PROTECT(R_MakeExternalPtr(set, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, route_set_finalizer, TRUE);
+  UNPROTECT(1);
+  return ptr;
+}
+
+// [[Rcpp::export(rng=false)]]
+bool cpp_route_set_match(SEXP ptr, const std::string& path) {
+  if (TYPEOF(ptr) != EXTPTRSXP || R_ExternalPtrAddr(ptr) == nullptr) {
+    Rcpp::stop("RouteSet is not initialized.");
+  }
+  return static_cast<const RouteSet*>(R_ExternalPtrAddr(ptr))->match(path);
+}
+
+// "exact", "partial" or NA if 'path' doesn't match, exact routes are checked first
+// [[Rcpp::export(rng=false)]]
+Rcpp::CharacterVector cpp_route_set_match_kind(SEXP ptr, const std::string& path) {
+  if (TYPEOF(ptr) != EXTPTRSXP || R_ExternalPtrAddr(ptr) == nullptr) {
+    Rcpp::stop("RouteSet is not initialized.");
+  }
+  const RouteSet* set = static_cast<const RouteSet*>(R_ExternalPtrAddr(ptr));
+  Rcpp::CharacterVector res(1);
+  if (set->match_exact(path)) {
+    res[0] = "exact";
+  } else if (set->match_prefix(path)) {
+    res[0] = "partial";
+  } else {
+    res[0] = NA_STRING;
+  }
+  return res;
+}
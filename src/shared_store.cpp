@@ -0,0 +1,697 @@
+#include <Rcpp.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <string>
+#ifndef _WIN32
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+#if !defined(_WIN32) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+// Key-value store shared between the R process and its forked children
+// (BackendRserve serves each request in a fork).
+// The whole table is a single anonymous MAP_SHARED mapping created before
+// the fork, so it contains no pointers - only offsets and fixed size slots:
+//
+//   [StoreHeader][StripeLock x stripes][Slot x buckets * ways]
+//
+// A key is hashed to a bucket of 'ways' slots (set-associative table), the
+// bucket is guarded by one of the striped spin locks. A new key takes an empty
+// or expired slot of its bucket, otherwise the least recently used slot of the
+// bucket is evicted, so the capacity is fixed and there is no rehashing.
+// Optional budget of the stored value bytes is shared by the whole table:
+// while a new value doesn't fit, the least recently used entry of the table
+// is evicted (a scan over all the slots, one stripe at a time).
+// Lock word keeps pid of the owner: if the owner was killed while holding the
+// lock, the lock is taken over and the slots of the stripe are cleared (they
+// could be half-written).
+// On Windows there is no fork, the table lives in the process memory.
+
+static const uint32_t store_ways = 8;
+
+enum SlotType : uint32_t {
+  SLOT_EMPTY = 0,
+  SLOT_RAW = 1,
+  SLOT_STRING = 2,
+  SLOT_COUNTER = 3
+};
+
+struct StoreHeader {
+  uint32_t n_buckets;
+  uint32_t n_stripes;
+  uint32_t max_key_size;
+  uint32_t max_value_size;
+  uint64_t slot_size;
+  // budget of the value bytes, 0 - no limit
+  uint64_t max_bytes;
+  std::atomic<uint64_t> bytes;
+  // logical clock of the slots access (LRU)
+  std::atomic<uint64_t> clock;
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+  std::atomic<uint64_t> evictions;
+};
+
+// one cache line per lock, so stripes don't share lines
+struct StripeLock {
+  std::atomic<int32_t> owner;
+  char pad[64 - sizeof(std::atomic<int32_t>)];
+};
+
+// followed by key and value bytes
+struct SlotHeader {
+  uint64_t hash;
+  uint64_t used;
+  // steady clock seconds, Inf - never
+  double expires;
+  uint32_t key_size;
+  uint32_t value_size;
+  uint32_t type;
+  uint32_t pad;
+};
+
+static std::size_t align_to(std::size_t x, std::size_t a) {
+  return (x + a - 1) / a * a;
+}
+
+// steady clock is system wide, so it is the same in all the processes
+static double now_seconds() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int32_t current_pid() {
+#ifndef _WIN32
+  return static_cast<int32_t>(getpid());
+#else
+  return static_cast<int32_t>(_getpid());
+#endif
+}
+
+static bool process_alive(int32_t pid) {
+#ifndef _WIN32
+  return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#else
+  (void)pid;
+  return true;
+#endif
+}
+
+static void cpu_yield() {
+#ifndef _WIN32
+  sched_yield();
+#endif
+}
+
+// key or value bytes of the R object, false if type is not supported.
+// Must be called outside of the stripe lock (translation can allocate)
+static bool sexp_bytes(SEXP x, const char*& data, std::size_t& size, uint32_t& type) {
+  if (TYPEOF(x) == RAWSXP) {
+    data = reinterpret_cast<const char*>(RAW(x));
+    size = static_cast<std::size_t>(Rf_xlength(x));
+    type = SLOT_RAW;
+    return true;
+  }
+  if (TYPEOF(x) == STRSXP && Rf_xlength(x) == 1 && STRING_ELT(x, 0) != NA_STRING) {
+    // strings are stored in UTF-8, so keys match regardless of the encoding
+    data = Rf_translateCharUTF8(STRING_ELT(x, 0));
+    size = std::strlen(data);
+    type = SLOT_STRING;
+    return true;
+  }
+  return false;
+}
+
+class SharedStore {
+public:
+  // nullptr if the memory can't be mapped (see errno)
+  static SharedStore* create(std::size_t capacity, std::size_t max_key_size,
+                             std::size_t max_value_size, std::size_t stripes,
+                             std::size_t max_bytes) {
+    std::size_t n_buckets = (capacity + store_ways - 1) / store_ways;
+    if (n_buckets == 0) {
+      n_buckets = 1;
+    }
+    if (stripes > n_buckets) {
+      stripes = n_buckets;
+    }
+    std::size_t slot_size = align_to(sizeof(SlotHeader) + max_key_size + max_value_size, 8);
+    std::size_t locks_offset = align_to(sizeof(StoreHeader), 64);
+    std::size_t slots_offset = locks_offset + stripes * sizeof(StripeLock);
+    double size = static_cast<double>(slots_offset) +
+      static_cast<double>(n_buckets) * store_ways * static_cast<double>(slot_size);
+    if (size > static_cast<double>(std::numeric_limits<std::size_t>::max() / 2)) {
+      errno = ENOMEM;
+      return nullptr;
+    }
+#ifndef _WIN32
+    // pages are allocated when they are touched, so large slots of the small
+    // values don't take memory (and are not accounted upfront)
+    int flags = MAP_SHARED | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    void* p = mmap(nullptr, static_cast<std::size_t>(size), PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p == MAP_FAILED) {
+      return nullptr;
+    }
+#else
+    void* p = std::calloc(static_cast<std::size_t>(size), 1);
+    if (p == nullptr) {
+      errno = ENOMEM;
+      return nullptr;
+    }
+#endif
+    return new SharedStore(static_cast<char*>(p), static_cast<std::size_t>(size), locks_offset,
+                           slots_offset, n_buckets, stripes, max_key_size, max_value_size,
+                           slot_size, max_bytes);
+  }
+
+  ~SharedStore() {
+    // mapping of this process only, forked children keep their own
+#ifndef _WIN32
+    munmap(base_, size_);
+#else
+    std::free(base_);
+#endif
+  }
+
+  // copies value of the key to 'value' (R objects are created by the caller
+  // outside of the lock), false if there is no such key
+  bool get(sv key, std::string& value, uint32_t& type) {
+    uint64_t hash = hash_bytes(key.data(), key.size());
+    uint32_t bucket = bucket_of(hash);
+    StripeGuard guard(*this, stripe_of(bucket));
+    SlotHeader* slot = find(bucket, hash, key, now_seconds());
+    if (slot == nullptr) {
+      return false;
+    }
+    slot->used = tick();
+    type = slot->type;
+    value.assign(value_of(slot), slot->value_size);
+    return true;
+  }
+
+  // false if key or value are larger than the slot (or the budget)
+  bool set(sv key, sv value, uint32_t type, double ttl) {
+    if (key.size() > header_->max_key_size || value.size() > header_->max_value_size) {
+      return false;
+    }
+    double now = now_seconds();
+    uint64_t hash = hash_bytes(key.data(), key.size());
+    uint32_t bucket = bucket_of(hash);
+    if (header_->max_bytes > 0 && !make_room(bucket, hash, key, value.size(), now)) {
+      return false;
+    }
+    StripeGuard guard(*this, stripe_of(bucket));
+    SlotHeader* slot = find(bucket, hash, key, now);
+    if (slot == nullptr) {
+      slot = take_slot(bucket, now);
+    }
+    write(slot, hash, key, value, type, now + ttl);
+    return true;
+  }
+
+  // returns false if the key holds a value which is not a counter
+  bool incr(sv key, int64_t by, double ttl, int64_t& res) {
+    uint64_t hash = hash_bytes(key.data(), key.size());
+    uint32_t bucket = bucket_of(hash);
+    double now = now_seconds();
+    StripeGuard guard(*this, stripe_of(bucket));
+    SlotHeader* slot = find(bucket, hash, key, now);
+    if (slot != nullptr) {
+      if (slot->type != SLOT_COUNTER) {
+        return false;
+      }
+      std::memcpy(&res, value_of(slot), sizeof(res));
+      res += by;
+      std::memcpy(value_of(slot), &res, sizeof(res));
+      slot->used = tick();
+      return true;
+    }
+    // TTL is set when the counter is created (fixed window)
+    res = by;
+    write(take_slot(bucket, now), hash, key, sv(reinterpret_cast<const char*>(&res), sizeof(res)),
+          SLOT_COUNTER, now + ttl);
+    return true;
+  }
+
+  bool remove(sv key) {
+    uint64_t hash = hash_bytes(key.data(), key.size());
+    uint32_t bucket = bucket_of(hash);
+    StripeGuard guard(*this, stripe_of(bucket));
+    SlotHeader* slot = find(bucket, hash, key, now_seconds());
+    if (slot == nullptr) {
+      return false;
+    }
+    free_slot(slot);
+    return true;
+  }
+
+  void clear() {
+    for (uint32_t s = 0; s < header_->n_stripes; ++s) {
+      StripeGuard guard(*this, s);
+      clear_stripe(s);
+    }
+  }
+
+  void count(bool hit) {
+    (hit ? header_->hits : header_->misses).fetch_add(1, std::memory_order_relaxed);
+  }
+
+  SEXP info() {
+    double now = now_seconds();
+    double entries = 0;
+    double bytes = 0;
+    for (uint32_t s = 0; s < header_->n_stripes; ++s) {
+      StripeGuard guard(*this, s);
+      for (uint32_t b = s; b < header_->n_buckets; b += header_->n_stripes) {
+        for (uint32_t w = 0; w < store_ways; ++w) {
+          SlotHeader* slot = slot_at(b, w);
+          if (slot->type != SLOT_EMPTY && slot->expires > now) {
+            ++entries;
+            bytes += slot->value_size;
+          }
+        }
+      }
+    }
+    static const char* names[] = {
+      "capacity", "entries", "bytes", "size", "hits", "misses", "evictions", ""
+    };
+    SEXP res = PROTECT(Rf_mkNamed(VECSXP, names));
+    SET_VECTOR_ELT(res, 0, Rf_ScalarReal(static_cast<double>(header_->n_buckets) * store_ways));
+    SET_VECTOR_ELT(res, 1, Rf_ScalarReal(entries));
+    SET_VECTOR_ELT(res, 2, Rf_ScalarReal(bytes));
+    SET_VECTOR_ELT(res, 3, Rf_ScalarReal(static_cast<double>(size_)));
+    SET_VECTOR_ELT(res, 4, Rf_ScalarReal(static_cast<double>(header_->hits.load())));
+    SET_VECTOR_ELT(res, 5, Rf_ScalarReal(static_cast<double>(header_->misses.load())));
+    SET_VECTOR_ELT(res, 6, Rf_ScalarReal(static_cast<double>(header_->evictions.load())));
+    UNPROTECT(1);
+    return res;
+  }
+
+  std::size_t max_key_size() const {
+    return header_->max_key_size;
+  }
+
+private:
+  char* base_;
+  std::size_t size_;
+  std::size_t locks_offset_;
+  std::size_t slots_offset_;
+  StoreHeader* header_;
+
+  SharedStore(char* base, std::size_t size, std::size_t locks_offset, std::size_t slots_offset,
+              std::size_t n_buckets, std::size_t stripes, std::size_t max_key_size,
+              std::size_t max_value_size, std::size_t slot_size, std::size_t max_bytes) :
+    base_(base), size_(size), locks_offset_(locks_offset), slots_offset_(slots_offset) {
+    // mapping is zero filled
+    header_ = new (base_) StoreHeader();
+    header_->n_buckets = static_cast<uint32_t>(n_buckets);
+    header_->n_stripes = static_cast<uint32_t>(stripes);
+    header_->max_key_size = static_cast<uint32_t>(max_key_size);
+    header_->max_value_size = static_cast<uint32_t>(max_value_size);
+    header_->slot_size = slot_size;
+    header_->max_bytes = max_bytes;
+    header_->bytes.store(0);
+    header_->clock.store(0);
+    header_->hits.store(0);
+    header_->misses.store(0);
+    header_->evictions.store(0);
+    for (std::size_t i = 0; i < stripes; ++i) {
+      new (lock_at(i)) StripeLock();
+      lock_at(i)->owner.store(0);
+    }
+  }
+
+  class StripeGuard {
+  public:
+    StripeGuard(SharedStore& store, uint32_t stripe) : store_(store), stripe_(stripe) {
+      store_.lock(stripe_);
+    }
+    ~StripeGuard() {
+      store_.unlock(stripe_);
+    }
+  private:
+    SharedStore& store_;
+    uint32_t stripe_;
+  };
+
+  StripeLock* lock_at(std::size_t i) const {
+    return reinterpret_cast<StripeLock*>(base_ + locks_offset_ + i * sizeof(StripeLock));
+  }
+
+  SlotHeader* slot_at(uint32_t bucket, uint32_t way) const {
+    std::size_t i = static_cast<std::size_t>(bucket) * store_ways + way;
+    return reinterpret_cast<SlotHeader*>(base_ + slots_offset_ + i * header_->slot_size);
+  }
+
+  static char* key_of(SlotHeader* slot) {
+    return reinterpret_cast<char*>(slot) + sizeof(SlotHeader);
+  }
+
+  char* value_of(SlotHeader* slot) const {
+    return key_of(slot) + header_->max_key_size;
+  }
+
+  uint32_t bucket_of(uint64_t hash) const {
+    return static_cast<uint32_t>(hash % header_->n_buckets);
+  }
+
+  uint32_t stripe_of(uint32_t bucket) const {
+    return bucket % header_->n_stripes;
+  }
+
+  uint64_t tick() {
+    return header_->clock.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void lock(uint32_t stripe) {
+    std::atomic<int32_t>& owner = lock_at(stripe)->owner;
+    int32_t self = current_pid();
+    for (unsigned spins = 1;; ++spins) {
+      int32_t expected = 0;
+      if (owner.compare_exchange_weak(expected, self, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        return;
+      }
+      if (spins < 64) {
+        continue;
+      }
+      cpu_yield();
+      // the owner could be killed inside of the critical section
+      if (spins % 1024 == 0 && expected != 0 && !process_alive(expected) &&
+          owner.compare_exchange_strong(expected, self, std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+        clear_stripe(stripe);
+        return;
+      }
+    }
+  }
+
+  void unlock(uint32_t stripe) {
+    lock_at(stripe)->owner.store(0, std::memory_order_release);
+  }
+
+  void clear_stripe(uint32_t stripe) {
+    for (uint32_t b = stripe; b < header_->n_buckets; b += header_->n_stripes) {
+      for (uint32_t w = 0; w < store_ways; ++w) {
+        free_slot(slot_at(b, w));
+      }
+    }
+  }
+
+  // live slot of the key, expired slot of the key is freed
+  SlotHeader* find(uint32_t bucket, uint64_t hash, sv key, double now) {
+    for (uint32_t w = 0; w < store_ways; ++w) {
+      SlotHeader* slot = slot_at(bucket, w);
+      if (slot->type == SLOT_EMPTY || slot->hash != hash || slot->key_size != key.size() ||
+          std::memcmp(key_of(slot), key.data(), key.size()) != 0) {
+        continue;
+      }
+      if (slot->expires <= now) {
+        free_slot(slot);
+        return nullptr;
+      }
+      return slot;
+    }
+    return nullptr;
+  }
+
+  // empty or expired slot of the bucket, otherwise least recently used one
+  SlotHeader* take_slot(uint32_t bucket, double now) {
+    SlotHeader* victim = nullptr;
+    for (uint32_t w = 0; w < store_ways; ++w) {
+      SlotHeader* slot = slot_at(bucket, w);
+      if (slot->type == SLOT_EMPTY || slot->expires <= now) {
+        return slot;
+      }
+      if (victim == nullptr || slot->used < victim->used) {
+        victim = slot;
+      }
+    }
+    header_->evictions.fetch_add(1, std::memory_order_relaxed);
+    return victim;
+  }
+
+  void free_slot(SlotHeader* slot) {
+    if (slot->type != SLOT_EMPTY) {
+      header_->bytes.fetch_sub(slot->value_size);
+      slot->type = SLOT_EMPTY;
+    }
+  }
+
+  // evicts entries until the value fits into the budget along with the other
+  // values (previous value of the key is replaced), false if it is too large
+  bool make_room(uint32_t bucket, uint64_t hash, sv key, std::size_t size, double now) {
+    if (size > header_->max_bytes) {
+      return false;
+    }
+    uint64_t replaced = 0;
+    {
+      StripeGuard guard(*this, stripe_of(bucket));
+      SlotHeader* slot = find(bucket, hash, key, now);
+      if (slot != nullptr) {
+        replaced = slot->value_size;
+      }
+    }
+    // other processes can fill the room in between, so the budget can be
+    // exceeded by the values written concurrently
+    while (header_->bytes.load() + size > header_->max_bytes + replaced && evict_lru(hash, now)) {}
+    return true;
+  }
+
+  // frees an expired or the least recently used slot of the whole table
+  // (except for the slots of the 'keep' hash), false if there is none
+  bool evict_lru(uint64_t keep, double now) {
+    uint32_t victim_bucket = 0;
+    uint32_t victim_way = 0;
+    uint64_t victim_used = std::numeric_limits<uint64_t>::max();
+    bool found = false;
+    for (uint32_t s = 0; s < header_->n_stripes; ++s) {
+      StripeGuard guard(*this, s);
+      for (uint32_t b = s; b < header_->n_buckets; b += header_->n_stripes) {
+        for (uint32_t w = 0; w < store_ways; ++w) {
+          SlotHeader* slot = slot_at(b, w);
+          if (slot->type == SLOT_EMPTY || slot->hash == keep) {
+            continue;
+          }
+          if (slot->expires <= now) {
+            free_slot(slot);
+            return true;
+          }
+          if (slot->used < victim_used) {
+            victim_bucket = b;
+            victim_way = w;
+            victim_used = slot->used;
+            found = true;
+          }
+        }
+      }
+    }
+    if (!found) {
+      return false;
+    }
+    StripeGuard guard(*this, stripe_of(victim_bucket));
+    SlotHeader* slot = slot_at(victim_bucket, victim_way);
+    // the slot could be used by other process after the scan
+    if (slot->type != SLOT_EMPTY && slot->used == victim_used) {
+      free_slot(slot);
+      header_->evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  void write(SlotHeader* slot, uint64_t hash, sv key, sv value, uint32_t type, double expires) {
+    free_slot(slot);
+    slot->hash = hash;
+    slot->used = tick();
+    slot->expires = expires;
+    slot->key_size = static_cast<uint32_t>(key.size());
+    slot->value_size = static_cast<uint32_t>(value.size());
+    slot->type = type;
+    header_->bytes.fetch_add(value.size());
+    std::memcpy(key_of(slot), key.data(), key.size());
+    if (!value.empty()) {
+      std::memcpy(value_of(slot), value.data(), value.size());
+    }
+  }
+};
+
+// native API for the other modules (response cache, file hashes)
+
+SharedStore* shared_store_new(std::size_t capacity, std::size_t max_key_size,
+                              std::size_t max_value_size, std::size_t stripes,
+                              std::size_t max_bytes) {
+  return SharedStore::create(capacity, max_key_size, max_value_size, stripes, max_bytes);
+}
+
+void shared_store_free(SharedStore* store) {
+  delete store;
+}
+
+bool shared_store_get(SharedStore* store, sv key, std::string& value) {
+  uint32_t type;
+  return store->get(key, value, type) && type == SLOT_RAW;
+}
+
+bool shared_store_set(SharedStore* store, sv key, sv value, double ttl) {
+  return store->set(key, value, SLOT_RAW, ttl);
+}
+
+void shared_store_clear(SharedStore* store) {
+  store->clear();
+}
+
+void shared_store_count(SharedStore* store, bool hit) {
+  store->count(hit);
+}
+
+SEXP shared_store_info(SharedStore* store) {
+  return store->info();
+}
+
+static void shared_store_finalizer(SEXP ptr) {
+  SharedStore* store = static_cast<SharedStore*>(R_ExternalPtrAddr(ptr));
+  if (store != nullptr) {
+    delete store;
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+static SharedStore* get_store(SEXP ptr) {
+  if (TYPEOF(ptr) != EXTPTRSXP || R_ExternalPtrAddr(ptr) == nullptr) {
+    Rcpp::stop("Shared store is not initialized.");
+  }
+  return static_cast<SharedStore*>(R_ExternalPtrAddr(ptr));
+}
+
+static sv get_key(SharedStore* store, SEXP key) {
+  const char* data;
+  std::size_t size;
+  uint32_t type;
+  if (TYPEOF(key) != STRSXP || !sexp_bytes(key, data, size, type)) {
+    Rcpp::stop("'key' should be a single string.");
+  }
+  if (size > store->max_key_size()) {
+    Rcpp::stop("'key' is longer than %d bytes.", static_cast<int>(store->max_key_size()));
+  }
+  return sv(data, size);
+}
+
+static double get_ttl(double ttl) {
+  if (std::isnan(ttl) || ttl <= 0) {
+    Rcpp::stop("'ttl' should be a positive number.");
+  }
+  return ttl;
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_shared_store_new(double capacity, double max_key_size, double max_value_size,
+                          double stripes) {
+  if (!(capacity >= 1) || !(max_key_size >= 1) || !(max_value_size >= 8) || !(stripes >= 1) ||
+      max_key_size > 1e9 || max_value_size > 1e9 || capacity > 4e9 || stripes > 1e6) {
+    Rcpp::stop("Invalid shared store parameters.");
+  }
+  SharedStore* store = SharedStore::create(
+    static_cast<std::size_t>(capacity),
+    static_cast<std::size_t>(max_key_size),
+    static_cast<std::size_t>(max_value_size),
+    static_cast<std::size_t>(stripes),
+    0
+  );
+  if (store == nullptr) {
+    Rcpp::stop("Can't map shared memory: %s.", std::strerror(errno));
+  }
+  SEXP ptr = PROTECT(R_MakeExternalPtr(store, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, shared_store_finalizer, TRUE);
+  UNPROTECT(1);
+  return ptr;
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_shared_store_get(SEXP ptr, SEXP key) {
+  SharedStore* store = get_store(ptr);
+  // value is copied under the lock, R objects are allocated after unlock
+  static std::string buf;
+  uint32_t type;
+  bool found = store->get(get_key(store, key), buf, type);
+  store->count(found);
+  if (!found) {
+    return R_NilValue;
+  }
+  if (type == SLOT_COUNTER) {
+    int64_t x;
+    std::memcpy(&x, buf.data(), sizeof(x));
+    return Rf_ScalarReal(static_cast<double>(x));
+  }
+  if (type == SLOT_STRING) {
+    return Rf_ScalarString(Rf_mkCharLenCE(buf.data(), static_cast<int>(buf.size()), CE_UTF8));
+  }
+  SEXP res = PROTECT(Rf_allocVector(RAWSXP, static_cast<R_xlen_t>(buf.size())));
+  if (!buf.empty()) {
+    std::memcpy(RAW(res), buf.data(), buf.size());
+  }
+  UNPROTECT(1);
+  return res;
+}
+
+// [[Rcpp::export(rng=false)]]
+bool cpp_shared_store_set(SEXP ptr, SEXP key, SEXP value, double ttl) {
+  SharedStore* store = get_store(ptr);
+  sv k = get_key(store, key);
+  const char* v;
+  std::size_t v_size;
+  uint32_t type;
+  if (!sexp_bytes(value, v, v_size, type)) {
+    Rcpp::stop("'value' should be a raw vector or a single string.");
+  }
+  return store->set(k, sv(v, v_size), type, get_ttl(ttl));
+}
+
+// [[Rcpp::export(rng=false)]]
+double cpp_shared_store_incr(SEXP ptr, SEXP key, double by, double ttl) {
+  SharedStore* store = get_store(ptr);
+  sv k = get_key(store, key);
+  if (std::isnan(by) || std::fabs(by) > 9007199254740992.0 || by != std::floor(by)) {
+    Rcpp::stop("'by' should be an integer number.");
+  }
+  int64_t res;
+  if (!store->incr(k, static_cast<int64_t>(by), get_ttl(ttl), res)) {
+    Rcpp::stop("Value of the key '%s' is not a counter.", std::string(k.data(), k.size()));
+  }
+  return static_cast<double>(res);
+}
+
+// [[Rcpp::export(rng=false)]]
+bool cpp_shared_store_delete(SEXP ptr, SEXP key) {
+  SharedStore* store = get_store(ptr);
+  return store->remove(get_key(store, key));
+}
+
+// [[Rcpp::export(rng=false)]]
+void cpp_shared_store_clear(SEXP ptr) {
+  get_store(ptr)->clear();
+}
+
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_shared_store_info(SEXP ptr) {
+  return get_store(ptr)->info();
+}
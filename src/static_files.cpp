@@ -0,0 +1,570 @@
+#include <Rcpp.h>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+#include "utils.h"
+
+using sv = nonstd::string_view;
+
+// Static files of Application$add_static() routes.
+// Directory is indexed once: content types, sizes, modification times,
+// ETags and 'Last-Modified' values are computed when the index is built.
+// Requests are answered from the index - conditional requests get 304
+// without touching the filesystem, small files are kept in memory (LRU with
+// byte budget), larger files are served by path, so the backend can send
+// them with sendfile().
+// Index is refreshed when inotify (Linux) reports changes in the directory.
+// Forked workers don't consume inotify events of the parent process, they
+// check requested files with stat() after a change instead. Without inotify
+// files are always checked with stat().
+
+struct StaticFile {
+  std::string key;
+  std::string path;
+  std::string content_type;
+  FileId id;
+  std::string etag;
+  std::string last_modified;
+  // slot with prepared 200 and 304 responses, -1 if they are not built yet
+  int slot = -1;
+  // whether 200 response holds the file content
+  bool cached = false;
+  std::list<std::string>::iterator lru;
+};
+
+static void append_hex(std::string& out, uint64_t x) {
+  static const char digits[] = "0123456789abcdef";
+  char buf[16];
+  int n = 0;
+  do {
+    buf[n++] = digits[x & 0xF];
+    x >>= 4;
+  } while (x != 0);
+  while (n > 0) {
+    out.push_back(buf[--n]);
+  }
+}
+
+static SEXP mk_string(const std::string& x) {
+  SEXP el = PROTECT(Rf_mkCharLenCE(x.data(), static_cast<int>(x.size()), CE_UTF8));
+  SEXP res = Rf_ScalarString(el);
+  UNPROTECT(1);
+  return res;
+}
+
+class StaticIndex {
+public:
+  StaticIndex(const std::string& url_path, const std::string& root,
+              const std::string& content_type,
+              const std::unordered_map<std::string, std::string>& types,
+              double cache_size, double cache_max_file, bool refresh) :
+    prefix_(url_path), root_(root), content_type_(content_type), types_(types),
+    cache_size_(cache_size), cache_max_file_(cache_max_file) {
+    while (root_.size() > 1 && root_.back() == '/') {
+      root_.pop_back();
+    }
+    struct stat st;
+    if (stat(root_.c_str(), &st) != 0) {
+      Rcpp::stop("Can't access '%s'.", root_);
+    }
+    is_dir_ = S_ISDIR(st.st_mode);
+    owner_pid_ = static_cast<long>(getpid());
+    if (refresh) {
+#ifdef __linux__
+      fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+      validate_ = fd_ < 0;
+    }
+    scan();
+  }
+  ~StaticIndex() {
+#ifdef __linux__
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+#endif
+  }
+  // returns list(status_code, body, content_type) with 'etag',
+  // 'last_modified' and 'path' attributes or NULL if file is not found
+  // 'headers' - request headers (named list with lower case names)
+  SEXP serve(sv path, SEXP headers) {
+    check_changes();
+    std::string key;
+    if (!resolve(path, key)) {
+      return R_NilValue;
+    }
+    StaticFile* f = find(key);
+    if (f == nullptr) {
+      return R_NilValue;
+    }
+    if (f->cached) {
+      lru_.splice(lru_.begin(), lru_, f->lru);
+    } else if (cache_file(*f, true) || f->slot < 0) {
+      prepare(*f);
+    }
+    SEXP responses = slots_.get(f->slot);
+    return VECTOR_ELT(responses, check_preconditions(*f, headers));
+  }
+private:
+  std::string prefix_;
+  std::string root_;
+  std::string content_type_;
+  std::unordered_map<std::string, std::string> types_;
+  double cache_size_;
+  double cache_max_file_;
+  double cache_bytes_ = 0;
+  bool is_dir_ = false;
+  // check files with stat() on each request
+  bool validate_ = false;
+  int fd_ = -1;
+  long owner_pid_;
+  std::unordered_map<std::string, StaticFile> files_;
+  // keys of the cached files, most recently used first
+  std::list<std::string> lru_;
+  SexpSlots slots_;
+
+  void scan() {
+    for (auto& it : files_) {
+      drop(it.second);
+    }
+    files_.clear();
+    if (is_dir_) {
+      scan_dir(root_, "");
+    } else {
+      watch(parent_dir(root_));
+      FileId id;
+      if (stat_file(root_.c_str(), id)) {
+        StaticFile& f = add("", root_, id);
+        if (cache_file(f, false)) {
+          prepare(f);
+        }
+      }
+    }
+  }
+
+  void scan_dir(const std::string& dir, const std::string& rel) {
+    watch(dir);
+    DIR* d = opendir(dir.c_str());
+    if (d == NULL) {
+      return;
+    }
+    std::vector<std::string> names;
+    while (struct dirent* e = readdir(d)) {
+      if (std::strcmp(e->d_name, ".") != 0 && std::strcmp(e->d_name, "..") != 0) {
+        names.emplace_back(e->d_name);
+      }
+    }
+    closedir(d);
+    for (const auto& name : names) {
+      std::string full = dir + "/" + name;
+      std::string key = rel.empty() ? name : rel + "/" + name;
+      struct stat st;
+#ifdef _WIN32
+      int rc = stat(full.c_str(), &st);
+#else
+      // symbolic links to directories are not followed
+      int rc = lstat(full.c_str(), &st);
+#endif
+      if (rc != 0) {
+        continue;
+      }
+      if (S_ISDIR(st.st_mode)) {
+        scan_dir(full, key);
+      } else {
+        FileId id;
+        if (stat_file(full.c_str(), id)) {
+          StaticFile& f = add(key, full, id);
+          // files are loaded up front, so forked workers get them from the parent
+          if (cache_file(f, false)) {
+            prepare(f);
+          }
+        }
+      }
+    }
+  }
+
+  static std::string parent_dir(const std::string& path) {
+    std::size_t pos = path.find_last_of('/');
+    return pos == std::string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+  }
+
+  void watch(const std::string& dir) {
+#ifdef __linux__
+    if (fd_ < 0) {
+      return;
+    }
+    uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+      IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+    if (inotify_add_watch(fd_, dir.c_str(), mask) < 0) {
+      // e.g. limit of watches is reached
+      validate_ = true;
+    }
+#else
+    (void) dir;
+#endif
+  }
+
+  void check_changes() {
+#ifdef __linux__
+    if (fd_ < 0 || validate_) {
+      return;
+    }
+    struct pollfd p;
+    p.fd = fd_;
+    p.events = POLLIN;
+    p.revents = 0;
+    if (poll(&p, 1, 0) <= 0 || !(p.revents & POLLIN)) {
+      return;
+    }
+    if (static_cast<long>(getpid()) != owner_pid_) {
+      // forked worker: events are left for the parent
+      validate_ = true;
+      return;
+    }
+    char buf[4096];
+    while (read(fd_, buf, sizeof(buf)) > 0) {}
+    scan();
+#endif
+  }
+
+  // maps request path to the index key
+  // returns false for the paths outside of the served directory
+  bool resolve(sv path, std::string& key) const {
+    if (path.size() < prefix_.size() || path.compare(0, prefix_.size(), prefix_) != 0) {
+      return false;
+    }
+    if (!is_dir_) {
+      key.clear();
+      return path.size() == prefix_.size();
+    }
+    sv rel = path.substr(prefix_.size());
+    key.clear();
+    key.reserve(rel.size());
+    std::size_t start = 0;
+    while (start <= rel.size()) {
+      std::size_t end = rel.find('/', start);
+      if (end == sv::npos) {
+        end = rel.size();
+      }
+      sv segment = rel.substr(start, end - start);
+      if (segment == "..") {
+        return false;
+      }
+      if (!segment.empty() && segment != ".") {
+        if (!key.empty()) {
+          key.push_back('/');
+        }
+        key.append(segment.data(), segment.size());
+      }
+      start = end + 1;
+    }
+    for (char c : key) {
+      if (c == '\0' || c == '\\') {
+        return false;
+      }
+    }
+    return !key.empty();
+  }
+
+  StaticFile* find(const std::string& key) {
+    auto it = files_.find(key);
+    if (!validate_) {
+      return it == files_.end() ? nullptr : &it->second;
+    }
+    std::string full = is_dir_ ? root_ + "/" + key : root_;
+    FileId id;
+    if (!stat_file(full.c_str(), id)) {
+      if (it != files_.end()) {
+        drop(it->second);
+        files_.erase(it);
+      }
+      return nullptr;
+    }
+    if (it != files_.end() && it->second.id == id) {
+      return &it->second;
+    }
+    return &add(key, full, id);
+  }
+
+  StaticFile& add(const std::string& key, const std::string& full, const FileId& id) {
+    StaticFile& f = files_[key];
+    drop(f);
+    f.key = key;
+    f.path = full;
+    f.id = id;
+    f.content_type = content_type_.empty() ? guess_type(full) : content_type_;
+    // strong validator from modification time (microseconds) and size
+    f.etag = "\"";
+    append_hex(f.etag, static_cast<uint64_t>(std::floor(id.mtime * 1e6)));
+    f.etag.push_back('-');
+    append_hex(f.etag, static_cast<uint64_t>(id.size));
+    f.etag.push_back('"');
+    char buf[64];
+    f.last_modified.assign(buf, format_http_date(std::floor(id.mtime), buf));
+    return f;
+  }
+
+  // removes prepared responses and cached content
+  void drop(StaticFile& f) {
+    if (f.cached) {
+      lru_.erase(f.lru);
+      cache_bytes_ -= f.id.size;
+      f.cached = false;
+    }
+    if (f.slot >= 0) {
+      slots_.remove(f.slot);
+      f.slot = -1;
+    }
+  }
+
+  // same rules as mime::guess_type(): extension is a trailing run of
+  // alphanumeric characters after the last dot
+  std::string guess_type(const std::string& path) const {
+    std::size_t end = path.size();
+    std::size_t pos = end;
+    while (pos > 0 && std::isalnum(static_cast<unsigned char>(path[pos - 1]))) {
+      --pos;
+    }
+    std::string ext;
+    if (pos > 0 && pos < end && path[pos - 1] == '.') {
+      ext = path.substr(pos);
+      str_lower(ext);
+    }
+    auto it = types_.find(ext);
+    return it == types_.end() ? "application/octet-stream" : it->second;
+  }
+
+  // whether file should be (and can be) kept in memory
+  // other files are evicted only if 'evict' is true
+  bool cache_file(StaticFile& f, bool evict) {
+    double size = f.id.size;
+    if (f.cached || size > cache_max_file_ || size > cache_size_) {
+      return false;
+    }
+    while (evict && cache_bytes_ + size > cache_size_ && !lru_.empty()) {
+      drop(files_.at(lru_.back()));
+    }
+    if (cache_bytes_ + size > cache_size_) {
+      return false;
+    }
+    lru_.push_front(f.key);
+    f.lru = lru_.begin();
+    f.cached = true;
+    cache_bytes_ += size;
+    if (f.slot >= 0) {
+      slots_.remove(f.slot);
+      f.slot = -1;
+    }
+    return true;
+  }
+
+  static SEXP read_file(const std::string& path, double size) {
+    SEXP res = PROTECT(Rf_allocVector(RAWSXP, static_cast<R_xlen_t>(size)));
+    std::FILE* in = std::fopen(path.c_str(), "rb");
+    bool ok = in != NULL;
+    if (ok) {
+      ok = std::fread(RAW(res), 1, static_cast<std::size_t>(size), in) == static_cast<std::size_t>(size);
+      std::fclose(in);
+    }
+    UNPROTECT(1);
+    return ok ? res : R_NilValue;
+  }
+
+  SEXP make_response(int status, SEXP body, const StaticFile& f) {
+    static const char* names[] = {"status_code", "body", "content_type", ""};
+    SEXP res = PROTECT(Rf_mkNamed(VECSXP, names));
+    SET_VECTOR_ELT(res, 0, Rf_ScalarInteger(status));
+    SET_VECTOR_ELT(res, 1, body);
+    SET_VECTOR_ELT(res, 2, mk_string(f.content_type));
+    SEXP etag_sym = Rf_install("etag");
+    Rf_setAttrib(res, etag_sym, PROTECT(mk_string(f.etag)));
+    SEXP last_modified_sym = Rf_install("last_modified");
+    Rf_setAttrib(res, last_modified_sym, PROTECT(mk_string(f.last_modified)));
+    SEXP path_sym = Rf_install("path");
+    Rf_setAttrib(res, path_sym, PROTECT(mk_string(f.path)));
+    UNPROTECT(4);
+    return res;
+  }
+
+  // builds 200, 304 and 412 responses for the file
+  void prepare(StaticFile& f) {
+    SEXP body = R_NilValue;
+    if (f.cached) {
+      body = read_file(f.path, f.id.size);
+      if (body == R_NilValue) {
+        lru_.erase(f.lru);
+        cache_bytes_ -= f.id.size;
+        f.cached = false;
+      }
+    }
+    if (body == R_NilValue) {
+      body = PROTECT(mk_string(f.path));
+      Rf_setAttrib(body, R_NamesSymbol, PROTECT(Rf_mkString("file")));
+      UNPROTECT(1);
+    } else {
+      PROTECT(body);
+    }
+    MARK_NOT_MUTABLE(body);
+    SEXP responses = PROTECT(Rf_allocVector(VECSXP, 3));
+    SET_VECTOR_ELT(responses, 0, make_response(200, body, f));
+    SET_VECTOR_ELT(responses, 1, make_response(304, R_NilValue, f));
+    SET_VECTOR_ELT(responses, 2, make_response(412, R_NilValue, f));
+    if (f.slot >= 0) {
+      slots_.remove(f.slot);
+    }
+    f.slot = slots_.add(responses);
+    UNPROTECT(2);
+  }
+
+  static SEXP get_header(SEXP headers, const char* name) {
+    SEXP names = Rf_getAttrib(headers, R_NamesSymbol);
+    if (TYPEOF(headers) != VECSXP || TYPEOF(names) != STRSXP) {
+      return R_NilValue;
+    }
+    for (R_xlen_t i = 0; i < Rf_xlength(headers); ++i) {
+      if (std::strcmp(CHAR(STRING_ELT(names, i)), name) == 0) {
+        SEXP value = VECTOR_ELT(headers, i);
+        return TYPEOF(value) == STRSXP && Rf_xlength(value) > 0 ? value : R_NilValue;
+      }
+    }
+    return R_NilValue;
+  }
+
+  // whether any of the entity tags in the header (values might be already
+  // split by comma) matches 'etag'
+  static bool etag_matches(SEXP header, const std::string& etag, bool weak) {
+    for (R_xlen_t i = 0; i < Rf_xlength(header); ++i) {
+      SEXP el = STRING_ELT(header, i);
+      if (el == NA_STRING) {
+        continue;
+      }
+      sv x(CHAR(el), LENGTH(el));
+      while (!x.empty()) {
+        std::size_t pos = x.find(',');
+        sv tag = sv_trim(x.substr(0, pos));
+        x = pos == sv::npos ? sv() : x.substr(pos + 1);
+        if (tag == "*") {
+          return true;
+        }
+        if (tag.size() > 2 && tag[0] == 'W' && tag[1] == '/') {
+          if (!weak) {
+            continue;
+          }
+          tag.remove_prefix(2);
+        }
+        if (tag == sv(etag)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  // seconds since epoch or NA, header might be split by comma
+  static double header_date(SEXP header) {
+    std::string value;
+    for (R_xlen_t i = 0; i < Rf_xlength(header); ++i) {
+      SEXP el = STRING_ELT(header, i);
+      if (el == NA_STRING) {
+        continue;
+      }
+      if (!value.empty()) {
+        value.append(", ");
+      }
+      value.append(CHAR(el), LENGTH(el));
+    }
+    return parse_http_date(value);
+  }
+
+  // evaluates conditional headers in the order of RFC 7232 section 6
+  // returns index of the prepared response: 0 - 200, 1 - 304, 2 - 412
+  static int check_preconditions(const StaticFile& f, SEXP headers) {
+    double mtime = std::floor(f.id.mtime);
+    SEXP im = get_header(headers, "if-match");
+    if (im != R_NilValue) {
+      if (!etag_matches(im, f.etag, false)) {
+        return 2;
+      }
+    } else {
+      SEXP ius = get_header(headers, "if-unmodified-since");
+      if (ius != R_NilValue) {
+        double since = header_date(ius);
+        if (!ISNAN(since) && mtime > since) {
+          return 2;
+        }
+      }
+    }
+    SEXP inm = get_header(headers, "if-none-match");
+    if (inm != R_NilValue) {
+      return etag_matches(inm, f.etag, true) ? 1 : 0;
+    }
+    SEXP ims = get_header(headers, "if-modified-since");
+    if (ims != R_NilValue) {
+      double since = header_date(ims);
+      if (!ISNAN(since) && mtime <= since) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+};
+
+static void static_index_finalizer(SEXP ptr) {
+  StaticIndex* index = static_cast<StaticIndex*>(R_ExternalPtrAddr(ptr));
+  if (index != nullptr) {
+    delete index;
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+// 'content_type' - content type of all the files or NULL to guess it from
+// file extensions with 'mime_types' (named by lower case extensions, name ""
+// is for files without extension)
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_static_index_new(const std::string& url_path, const std::string& file_path,
+                          SEXP content_type, Rcpp::CharacterVector mime_types,
+                          double cache_size = 16777216, double cache_max_file = 65536,
+                          bool refresh = true) {
+  std::string type;
+  if (TYPEOF(content_type) == STRSXP && Rf_xlength(content_type) == 1 &&
+      STRING_ELT(content_type, 0) != NA_STRING) {
+    type = CHAR(STRING_ELT(content_type, 0));
+  }
+  std::unordered_map<std::string, std::string> types;
+  SEXP names = Rf_getAttrib(mime_types, R_NamesSymbol);
+  if (mime_types.size() > 0 && TYPEOF(names) != STRSXP) {
+    Rcpp::stop("'mime_types' must be named.");
+  }
+  for (R_xlen_t i = 0; i < mime_types.size(); ++i) {
+    if (mime_types[i] != NA_STRING) {
+      types.emplace(CHAR(STRING_ELT(names, i)), CHAR(STRING_ELT(mime_types, i)));
+    }
+  }
+  StaticIndex* index = new StaticIndex(url_path, file_path, type, types,
+                                       cache_size, cache_max_file, refresh);
+  SEXP ptr = PROTECT(R_MakeExternalPtr(index, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, static_index_finalizer, TRUE);
+  UNPROTECT(1);
+  return ptr;
+}
+
+// 'headers' - request headers
+// [[Rcpp::export(rng=false)]]
+SEXP cpp_static_serve(SEXP ptr, const std::string& path, SEXP headers = R_NilValue) {
+  if (TYPEOF(ptr) != EXTPTRSXP || R_ExternalPtrAddr(ptr) == nullptr) {
+    Rcpp::stop("Static files index is not initialized.");
+  }
+  return static_cast<StaticIndex*>(R_ExternalPtrAddr(ptr))->serve(path, headers);
+}
@@ -1,41 +1,96 @@
-#include <cctype>
-#include <iostream>
+#include <cstring>
 #include <string>
-#include <sstream>
+#include <vector>
 #include <Rcpp.h>
+#include "utils.h"
 
-static inline char from_hex(char ch) {
-  return std::isdigit(ch) ? ch - '0' : std::tolower(ch) - 'a' + 10;
+// hex digit value or -1 for non hex characters
+static const signed char hex_value[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x00
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x10
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x20
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1, // 0x30
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x40
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x50
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x60
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x70
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x80
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0x90
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xA0
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xB0
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xC0
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xD0
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, // 0xE0
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1  // 0xF0
+};
+
+// position of the first byte which needs decoding ('%' or '+')
+static inline const char* url_decode_find(const char* s, const char* end, bool plus_as_space) {
+  while (s < end && *s != '%' && (*s != '+' || !plus_as_space)) {
+    ++s;
+  }
+  return s;
 }
 
-std::string url_decode_one(const std::string& value) {
-  std::ostringstream escaped;
-  escaped.fill('0');
-  for (auto cur = value.begin(), end = value.end(); cur != end; ++cur) {
-    std::string::value_type c = (*cur);
-    if (c == '%') {
-      if (cur[1] && cur[2]) {
-        char h = from_hex(cur[1]) << 4 | from_hex(cur[2]);
-        escaped << h;
-        cur += 2;
+// decode string to the buffer of size n (decoded string is never longer)
+// returns size of the decoded string
+// malformed escapes (not followed by two hex digits) and '%00' are kept as is
+// '+' is decoded as space for the form encoding (but not for RFC 5987 values)
+std::size_t url_decode_to(const char* s, std::size_t n, char* out, bool plus_as_space) {
+  const char* end = s + n;
+  char* out_start = out;
+  while (s < end) {
+    const char* run = url_decode_find(s, end, plus_as_space);
+    std::memcpy(out, s, run - s);
+    out += run - s;
+    s = run;
+    if (s == end) {
+      break;
+    }
+    if (*s == '+') {
+      *out++ = ' ';
+      ++s;
+      continue;
+    }
+    if (end - s >= 3) {
+      int hi = hex_value[static_cast<unsigned char>(s[1])];
+      int lo = hex_value[static_cast<unsigned char>(s[2])];
+      if (hi >= 0 && lo >= 0 && (hi | lo) != 0) {
+        *out++ = static_cast<char>(hi << 4 | lo);
+        s += 3;
+        continue;
       }
-    } else if (c == '+') {
-      escaped << ' ';
-    } else {
-      escaped << c;
     }
+    *out++ = *s++;
   }
+  return out - out_start;
+}
 
-  return escaped.str();
+static SEXP url_decode_one(SEXP x, std::vector<char>& buf) {
+  if (x == NA_STRING) {
+    return Rf_mkChar("NA");
+  }
+  const char* s = CHAR(x);
+  std::size_t n = LENGTH(x);
+  // nothing to decode - reuse input CHARSXP
+  if (url_decode_find(s, s + n, true) == s + n) {
+    return x;
+  }
+  if (buf.size() < n) {
+    buf.resize(n);
+  }
+  std::size_t res_n = url_decode_to(s, n, buf.data());
+  return Rf_mkCharLen(buf.data(), res_n);
 }
 
-// [[Rcpp::export]]
+// [[Rcpp::export(rng=false)]]
 Rcpp::CharacterVector cpp_url_decode(Rcpp::CharacterVector x) {
-  std::size_t n = x.size();
+  R_xlen_t n = x.size();
   Rcpp::CharacterVector out = Rcpp::no_init(n);
-  for (std::size_t i = 0; i < n; ++i) {
-    std::string cur = Rcpp::as<std::string>(x[i]);
-    out[i] = url_decode_one(cur);
+  // single buffer for the whole vector
+  std::vector<char> buf;
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SET_STRING_ELT(out, i, url_decode_one(STRING_ELT(x, i), buf));
   }
   return out;
 }
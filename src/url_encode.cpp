@@ -1,40 +1,86 @@
-#include <locale>
-#include <iomanip>
+#include <cstring>
 #include <string>
-#include <sstream>
+#include <vector>
 #include <Rcpp.h>
+#include "utils.h"
 
-std::string url_encode_one(const std::string& value) {
-  std::locale loc("C");
-  std::ostringstream escaped;
-  escaped.fill('0');
-  escaped << std::hex;
-  for (auto cur = value.begin(), end = value.end(); cur != end; ++cur) {
-    std::string::value_type c = (*cur);
-    // Keep alphanumeric and other accepted characters
-    // See: https://tools.ietf.org/html/rfc3986#section-2.3
-    if (std::isalnum(c, loc) || c == '-' || c == '.' || c == '_' || c == '~') {
-      escaped << c;
-      continue;
+// unreserved characters are kept as is, any other are percent-encoded
+// See: https://tools.ietf.org/html/rfc3986#section-2.3
+static const bool url_unreserved[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x00
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, // 0x20
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, // 0x30
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x40
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1, // 0x50
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, // 0x60
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0, // 0x70
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x80
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x90
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xA0
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xB0
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xC0
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xD0
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xE0
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  // 0xF0
+};
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+// size of the encoded string: each escaped byte takes 3 bytes instead of 1
+std::size_t url_encoded_size(const char* s, std::size_t n) {
+  std::size_t res = n;
+  for (std::size_t i = 0; i < n; ++i) {
+    res += url_unreserved[static_cast<unsigned char>(s[i])] ? 0 : 2;
+  }
+  return res;
+}
+
+// write encoded string to the buffer of size url_encoded_size()
+void url_encode_to(const char* s, std::size_t n, char* out) {
+  const char* end = s + n;
+  while (s < end) {
+    // copy run of unreserved characters at once
+    const char* run = s;
+    while (s < end && url_unreserved[static_cast<unsigned char>(*s)]) {
+      ++s;
     }
-    // Any other characters are percent-encoded
-    escaped << std::uppercase;
-    escaped << '%' << std::setw(2);
-    escaped << static_cast<int>(static_cast<unsigned char>(c));
-    escaped << std::nouppercase;
+    std::memcpy(out, run, s - run);
+    out += s - run;
+    if (s == end) {
+      break;
+    }
+    unsigned char c = static_cast<unsigned char>(*s++);
+    *out++ = '%';
+    *out++ = hex_digits[c >> 4];
+    *out++ = hex_digits[c & 0x0F];
   }
+}
 
-  return escaped.str();
+static SEXP url_encode_one(SEXP x, std::vector<char>& buf) {
+  if (x == NA_STRING) {
+    return Rf_mkChar("NA");
+  }
+  const char* s = CHAR(x);
+  std::size_t n = LENGTH(x);
+  std::size_t res_n = url_encoded_size(s, n);
+  // nothing to escape - reuse input CHARSXP
+  if (res_n == n) {
+    return x;
+  }
+  buf.resize(res_n);
+  url_encode_to(s, n, buf.data());
+  return Rf_mkCharLen(buf.data(), res_n);
 }
 
-// [[Rcpp::export]]
+// [[Rcpp::export(rng=false)]]
 Rcpp::CharacterVector cpp_url_encode(Rcpp::CharacterVector x) {
-  std::size_t n = x.size();
+  R_xlen_t n = x.size();
   Rcpp::CharacterVector out = Rcpp::no_init(n);
-  for (std::size_t i = 0; i < n; ++i) {
-    std::string cur = Rcpp::as<std::string>(x[i]);
-    out[i] = url_encode_one(cur);
+  // single buffer for the whole vector
+  std::vector<char> buf;
+  for (R_xlen_t i = 0; i < n; ++i) {
+    SET_STRING_ELT(out, i, url_encode_one(STRING_ELT(x, i), buf));
   }
-
   return out;
 }
@@ -1,10 +1,12 @@
 #ifndef H_UTILS
 #define H_UTILS
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include <Rcpp.h>
+#include "nonstd/string_view.hpp"
 
 void str_ltrim(std::string&);
 void str_rtrim(std::string&);
@@ -13,6 +15,12 @@ void str_lower(std::string&);
 void str_upper(std::string&);
 void str_split(const std::string&, std::vector<std::string>&, const char, bool);
 void str_split(const std::string&, std::vector<std::string>&, const std::string&, bool);
+bool is_space(char);
+extern const bool tchar_table[256];
+inline bool is_tchar(char c) {
+  return tchar_table[static_cast<unsigned char>(c)];
+}
+nonstd::string_view sv_trim(nonstd::string_view);
 bool str_starts_with(const std::string&, const std::string&);
 bool str_ends_with(const std::string&, const std::string&);
 template <typename T>
@@ -20,6 +28,90 @@ std::string str_join(const std::vector<T>&, const char*);
 std::string str_join(Rcpp::CharacterVector, const char*);
 template<typename T>
 Rcpp::Environment map_to_env(const std::unordered_map<std::string,T>&);
+std::size_t url_encoded_size(const char*, std::size_t);
+void url_encode_to(const char*, std::size_t, char*);
+std::size_t url_decode_to(const char*, std::size_t, char*, bool plus_as_space = true);
+std::int64_t days_from_civil(std::int64_t, int, int);
+void civil_from_days(std::int64_t, std::int64_t&, int&, int&);
+std::size_t format_http_date(double, char*);
+double parse_http_date(nonstd::string_view);
+// identity of the regular file content, filled by stat_file()
+struct FileId {
+  double dev;
+  double ino;
+  double size;
+  double mtime;
+  bool operator==(const FileId& other) const {
+    return dev == other.dev && ino == other.ino && size == other.size && mtime == other.mtime;
+  }
+};
+bool stat_file(const char*, FileId&);
+// xxHash64 (seed = 0) of the bytes
+uint64_t hash_bytes(const char*, std::size_t);
+void json_write_string(std::string&, const char*, std::size_t);
 Rcpp::RawVector raw_slice(const Rcpp::RawVector &x, const R_xlen_t offset, const R_xlen_t size);
+// fixed capacity key-value store in shared memory (see shared_store.cpp),
+// store created before fork() is shared with the forked children
+class SharedStore;
+// 'max_bytes' - budget of the stored values (0 - only 'capacity' is limited)
+SharedStore* shared_store_new(std::size_t capacity, std::size_t max_key_size,
+                              std::size_t max_value_size, std::size_t stripes,
+                              std::size_t max_bytes = 0);
+void shared_store_free(SharedStore*);
+bool shared_store_get(SharedStore*, nonstd::string_view key, std::string& value);
+bool shared_store_set(SharedStore*, nonstd::string_view key, nonstd::string_view value, double ttl);
+void shared_store_clear(SharedStore*);
+void shared_store_count(SharedStore*, bool hit);
+SEXP shared_store_info(SharedStore*);
+// R objects owned by native objects (static files index, response cache) are
+// kept in a single preserved list, freed slots are reused
+class SexpSlots {
+public:
+  SexpSlots() {}
+  ~SexpSlots() {
+    if (list_ != R_NilValue) {
+      R_ReleaseObject(list_);
+    }
+  }
+  // 'x' must be protected by the caller
+  int add(SEXP x) {
+    int i;
+    if (!free_.empty()) {
+      i = free_.back();
+      free_.pop_back();
+    } else {
+      if (list_ == R_NilValue || size_ == Rf_xlength(list_)) {
+        grow();
+      }
+      i = size_++;
+    }
+    SET_VECTOR_ELT(list_, i, x);
+    return i;
+  }
+  SEXP get(int i) const {
+    return VECTOR_ELT(list_, i);
+  }
+  void remove(int i) {
+    SET_VECTOR_ELT(list_, i, R_NilValue);
+    free_.push_back(i);
+  }
+private:
+  SEXP list_ = R_NilValue;
+  int size_ = 0;
+  std::vector<int> free_;
+  void grow() {
+    R_xlen_t n = list_ == R_NilValue ? 0 : Rf_xlength(list_);
+    SEXP x = PROTECT(Rf_allocVector(VECSXP, n == 0 ? 64 : 2 * n));
+    for (R_xlen_t i = 0; i < n; ++i) {
+      SET_VECTOR_ELT(x, i, VECTOR_ELT(list_, i));
+    }
+    R_PreserveObject(x);
+    UNPROTECT(1);
+    if (list_ != R_NilValue) {
+      R_ReleaseObject(list_);
+    }
+    list_ = x;
+  }
+};
 
 #endif